@@ -4,20 +4,25 @@
 #include "src/common/common.h"
 #include "src/slider/slider.h"
 #include "src/common/logger/logger.h"
+#include "src/least_squares/poly_fit.h"
+#include "src/render/point_render.h"
 
 using namespace cv;
 using namespace std;
 
-vector<Point2d> readPointsFile(string filePath);
+vector<Point2d> readPointsFile(string filePath, PointBounds* bounds = nullptr);
 void drawCross(Mat img, int cx, int cy, int halfSize = 3, int thickness = 1, uchar color = 0);
-Mat drawPointsImage(vector<Point2d> points);
+Mat drawPointsImage(const vector<Point2d>& points, const PointBounds& bounds, const PointRenderOptions& options = {});
+void drawPolynomial(Mat img, const PlotFrame& frame, const double* coefficients, int degree, double fromX, double toX);
 
 int main() {
     Logger::init();
 
     // Choose which file to open
     string filepath = "assets/points_LeastSquares/points1.txt";
-    vector<Point2d> points = readPointsFile(filepath);
+    // The bounds are gathered while reading, so rendering makes one pass over the points
+    PointBounds bounds;
+    vector<Point2d> points = readPointsFile(filepath, &bounds);
 
     if (points.empty()) {
         ERROR("No points to display");
@@ -25,7 +30,29 @@ int main() {
         return -1;
     }
 
-    Mat result = drawPointsImage(points);
+    Mat result = drawPointsImage(points, bounds);
+
+    // Fit a low-degree polynomial to every point file at once, in one batch
+    const int degree = 2;
+    PointSeriesBatch batch;
+    for (int i = 0; i <= 5; i++) {
+        batch.addSeries(readPointsFile("assets/points_LeastSquares/points" + to_string(i) + ".txt"));
+    }
+
+    BatchPolyFitter fitter(degree, PolyFitMethod::HOUSEHOLDER_QR);
+    PolyFitResults fits;
+    fitter.fit(batch, fits);
+
+    for (size_t i = 0; i < batch.size(); i++) {
+        const double* c = fits.coefficientsOf(i);
+        INFO("points{}.txt: valid={} c0={:.4f} c1={:.4f} c2={:.6f} rms={:.4f}", i, fits.valid[i], c[0], c[1], c[2], fits.rms[i]);
+    }
+
+    // Overlay the fit of the displayed file (points1.txt)
+    if (fits.valid[1]) {
+        PlotFrame frame = computePlotFrame(bounds);
+        drawPolynomial(result, frame, fits.coefficientsOf(1), degree, bounds.minX, bounds.maxX);
+    }
 
     // Show result
     imshow("Points", result);
@@ -35,7 +62,7 @@ int main() {
     return 0;
 }
 
-vector<Point2d> readPointsFile(string filepath) {
+vector<Point2d> readPointsFile(string filepath, PointBounds* bounds) {
     ifstream fin(filepath);
     vector<Point2d> pts;
 
@@ -59,6 +86,9 @@ vector<Point2d> readPointsFile(string filepath) {
 
     while (fin >> x >> y) {
         pts.emplace_back(x, y);
+        if (bounds) {
+            bounds->add(x, y);
+        }
         read++;
         if (read >= n) break;
     }
@@ -76,41 +106,40 @@ void drawCross(Mat img, int cx, int cy, int halfSize, int thickness, uchar color
     line(img, Point(cx, cy - halfSize), Point(cx, cy + halfSize), color, thickness, LINE_AA);
 }
 
-Mat drawPointsImage(vector<Point2d> points) {
-    int W = 500, H = 500, pad = 20;
-    Mat canvas(H, W, CV_8UC1, Scalar(255));
+Mat drawPointsImage(const vector<Point2d>& points, const PointBounds& bounds, const PointRenderOptions& options) {
+    PlotFrame frame = computePlotFrame(bounds);
+    int W = frame.W, H = frame.H;
 
-    // Find min/max for normalization
-    double minX = numeric_limits<double>::max();
-    double minY = numeric_limits<double>::max();
-    double maxX = numeric_limits<double>::lowest();
-    double maxY = numeric_limits<double>::lowest();
-
-    for (auto p : points) {
-        minX = min(minX, p.x);
-        minY = min(minY, p.y);
-        maxX = max(maxX, p.x);
-        maxY = max(maxY, p.y);
+    // Large point sets are shown as a density image, binned in one pass
+    if (points.size() > options.crossLimit) {
+        return renderDensity(binPointDensity(points, frame), options);
     }
 
-    double spanX = maxX - minX;
-    double spanY = maxY - minY;
-    if (spanX == 0) spanX = 1;
-    if (spanY == 0) spanY = 1;
-
-    double scaleX = (W - 2.0 * pad) / spanX;
-    double scaleY = (H - 2.0 * pad) / spanY;
-    double scale = min(scaleX, scaleY);
+    Mat canvas(H, W, CV_8UC1, Scalar(255));
 
     // Draw each point
-    for (auto p : points) {
-        int xImg = (int)(pad + (p.x - minX) * scale);
-        int yImg = (int)(H - pad - (p.y - minY) * scale); // flip y
+    for (const Point2d& p : points) {
+        Point c = frame.toCanvas(p.x, p.y);
 
-        if (xImg >= 0 && xImg < W && yImg >= 0 && yImg < H) {
-            drawCross(canvas, xImg, yImg, 3, 1, 0);
+        if (c.x >= 0 && c.x < W && c.y >= 0 && c.y < H) {
+            drawCross(canvas, c.x, c.y, 3, 1, 0);
         }
     }
 
     return canvas;
-}
\ No newline at end of file
+}
+
+void drawPolynomial(Mat img, const PlotFrame& frame, const double* coefficients, int degree, double fromX, double toX) {
+    // Sample the curve once per canvas column and join the samples
+    int steps = max(1, (int)((toX - fromX) * frame.scale));
+    vector<Point> curve;
+    curve.reserve(steps + 1);
+
+    for (int i = 0; i <= steps; i++) {
+        double x = fromX + (toX - fromX) * i / steps;
+        curve.push_back(frame.toCanvas(x, evaluatePolynomial(coefficients, degree, x)));
+    }
+
+    // Gray on the grayscale canvas and on the color density image alike
+    polylines(img, curve, false, Scalar(128, 128, 128), 1, LINE_AA);
+}
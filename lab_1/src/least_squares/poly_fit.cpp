@@ -0,0 +1,322 @@
+#include "poly_fit.h"
+#include "../common/logger/logger.h"
+
+#include <algorithm>
+#include <cmath>
+
+void PointSeriesBatch::reserve(std::size_t seriesCount, std::size_t pointCount)
+{
+  xs.reserve(pointCount);
+  ys.reserve(pointCount);
+  offsets.reserve(seriesCount + 1);
+}
+
+void PointSeriesBatch::addSeries(const std::vector<cv::Point2d> &points)
+{
+  for (const cv::Point2d &p : points) {
+    xs.push_back(p.x);
+    ys.push_back(p.y);
+  }
+  offsets.push_back(xs.size());
+}
+
+void PointSeriesBatch::clear()
+{
+  xs.clear();
+  ys.clear();
+  offsets.assign(1, 0);
+}
+
+std::size_t PointSeriesBatch::maxLength() const
+{
+  std::size_t longest = 0;
+  for (std::size_t i = 0; i < size(); i++) {
+    longest = std::max(longest, length(i));
+  }
+  return longest;
+}
+
+void PolyFitWorkspace::reserve(int degree, std::size_t maxPoints, PolyFitMethod method)
+{
+  if (method != PolyFitMethod::HOUSEHOLDER_QR) {
+    return;
+  }
+  // resize() only reallocates when the batch has a longer series than any seen before
+  if (design.size() < maxPoints * (degree + 1)) {
+    design.resize(maxPoints * (degree + 1));
+  }
+  if (rhs.size() < maxPoints) {
+    rhs.resize(maxPoints);
+  }
+}
+
+double evaluatePolynomial(const double *coefficients, int degree, double x)
+{
+  double value = coefficients[degree];
+  for (int j = degree - 1; j >= 0; j--) {
+    value = value * x + coefficients[j];
+  }
+  return value;
+}
+
+// The fit is done in u = (x - shift) / scale, which keeps every power of u in
+// [-1, 1]. This converts the coefficients back to powers of x.
+static void denormalizeCoefficients(double *c, int degree, double shift, double scale)
+{
+  double d[kMaxPolyDegree + 1];
+  double out[kMaxPolyDegree + 1] = {};
+  double invScalePow = 1.0;
+  for (int j = 0; j <= degree; j++) {
+    d[j] = c[j] * invScalePow;
+    invScalePow /= scale;
+  }
+
+  // (x - shift)^j = sum_i C(j, i) x^i (-shift)^(j - i)
+  for (int j = 0; j <= degree; j++) {
+    double binom = 1.0;    // C(j, i), starting at i = j
+    double shiftPow = 1.0; // (-shift)^(j - i)
+    for (int i = j; i >= 0; i--) {
+      out[i] += d[j] * binom * shiftPow;
+      binom = binom * i / (j - i + 1);
+      shiftPow *= -shift;
+    }
+  }
+
+  std::copy(out, out + degree + 1, c);
+}
+
+// Householder QR of the m x n design matrix, applied to y on the fly.
+// Returns the residual sum of squares, or a negative value when rank deficient.
+static double fitSeriesQR(const double *xs, const double *ys, std::size_t m, int degree,
+                          double shift, double scale, PolyFitWorkspace &ws, double *c)
+{
+  const int n = degree + 1;
+  double *A = ws.design.data();
+  double *b = ws.rhs.data();
+  double rdiag[kMaxPolyDegree + 1];
+
+  for (std::size_t i = 0; i < m; i++) {
+    double u = (xs[i] - shift) / scale;
+    double power = 1.0;
+    for (int j = 0; j < n; j++) {
+      A[j * m + i] = power;
+      power *= u;
+    }
+    b[i] = ys[i];
+  }
+
+  const double tolerance = 1e-12 * std::sqrt((double)m);
+
+  for (int j = 0; j < n; j++) {
+    double *v = A + j * m;
+
+    double norm = 0.0;
+    for (std::size_t i = j; i < m; i++) {
+      norm += v[i] * v[i];
+    }
+    norm = std::sqrt(norm);
+
+    if (norm <= tolerance) {
+      return -1.0;
+    }
+
+    // Reflect onto alpha * e_j with the sign chosen to avoid cancellation
+    double alpha = v[j] > 0 ? -norm : norm;
+    double vtv = 2.0 * norm * (norm + std::abs(v[j]));
+    v[j] -= alpha;
+    rdiag[j] = alpha;
+
+    // Reflect the remaining columns and the right hand side
+    for (int k = j + 1; k <= n; k++) {
+      double *col = k < n ? A + k * m : b;
+      double dot = 0.0;
+      for (std::size_t i = j; i < m; i++) {
+        dot += v[i] * col[i];
+      }
+      double f = 2.0 * dot / vtv;
+      for (std::size_t i = j; i < m; i++) {
+        col[i] -= f * v[i];
+      }
+    }
+  }
+
+  // Back substitution R c = Q^T y
+  for (int j = n - 1; j >= 0; j--) {
+    double sum = b[j];
+    for (int k = j + 1; k < n; k++) {
+      sum -= A[k * m + j] * c[k];
+    }
+    c[j] = sum / rdiag[j];
+  }
+
+  // The tail of Q^T y is exactly the residual vector
+  double rss = 0.0;
+  for (std::size_t i = n; i < m; i++) {
+    rss += b[i] * b[i];
+  }
+  return rss;
+}
+
+// Cholesky factorization of the Gram matrix A^T A, accumulated in a single pass
+// over the points without materializing A.
+static double fitSeriesCholesky(const double *xs, const double *ys, std::size_t m, int degree,
+                                double shift, double scale, double *c)
+{
+  const int n = degree + 1;
+  double G[kMaxPolyDegree + 1][kMaxPolyDegree + 1] = {};
+  double moments[2 * kMaxPolyDegree + 1] = {};
+  double aty[kMaxPolyDegree + 1] = {};
+
+  // G is a Hankel matrix: G[j][k] = sum u^(j + k)
+  for (std::size_t i = 0; i < m; i++) {
+    double u = (xs[i] - shift) / scale;
+    double power = 1.0;
+    for (int j = 0; j < 2 * n - 1; j++) {
+      moments[j] += power;
+      if (j < n) {
+        aty[j] += power * ys[i];
+      }
+      power *= u;
+    }
+  }
+  for (int j = 0; j < n; j++) {
+    for (int k = 0; k < n; k++) {
+      G[j][k] = moments[j + k];
+    }
+  }
+
+  // In place G = L L^T, lower triangle
+  const double tolerance = 1e-13 * moments[0];
+  for (int j = 0; j < n; j++) {
+    double diag = G[j][j];
+    for (int k = 0; k < j; k++) {
+      diag -= G[j][k] * G[j][k];
+    }
+    if (diag <= tolerance) {
+      return -1.0;
+    }
+    G[j][j] = std::sqrt(diag);
+
+    for (int i = j + 1; i < n; i++) {
+      double sum = G[i][j];
+      for (int k = 0; k < j; k++) {
+        sum -= G[i][k] * G[j][k];
+      }
+      G[i][j] = sum / G[j][j];
+    }
+  }
+
+  // Solve L z = A^T y, then L^T c = z
+  for (int j = 0; j < n; j++) {
+    double sum = aty[j];
+    for (int k = 0; k < j; k++) {
+      sum -= G[j][k] * c[k];
+    }
+    c[j] = sum / G[j][j];
+  }
+  for (int j = n - 1; j >= 0; j--) {
+    double sum = c[j];
+    for (int k = j + 1; k < n; k++) {
+      sum -= G[k][j] * c[k];
+    }
+    c[j] = sum / G[j][j];
+  }
+
+  // The normal equations lose the residual to cancellation, so recompute it
+  double rss = 0.0;
+  for (std::size_t i = 0; i < m; i++) {
+    double r = ys[i] - evaluatePolynomial(c, degree, (xs[i] - shift) / scale);
+    rss += r * r;
+  }
+  return rss;
+}
+
+BatchPolyFitter::BatchPolyFitter(int degree, PolyFitMethod method)
+  :degree(degree), method(method)
+{
+}
+
+void BatchPolyFitter::fit(const PointSeriesBatch &batch, PolyFitResults &results)
+{
+  const std::size_t count = batch.size();
+
+  // The per-series scratch is sized for kMaxPolyDegree
+  if (degree < 0 || degree > kMaxPolyDegree) {
+    ERROR("Polynomial degree {} is outside [0, {}]. Marking every series invalid.", degree, kMaxPolyDegree);
+    results.degree = degree;
+    results.coefficients.clear();
+    results.rms.assign(count, 0.0);
+    results.valid.assign(count, 0);
+    return;
+  }
+
+  const int n = degree + 1;
+  results.degree = degree;
+  results.coefficients.resize(count * n);
+  results.rms.resize(count);
+  results.valid.resize(count);
+
+  if (count == 0) {
+    return;
+  }
+
+  // One workspace per worker, grown up front so the parallel region never allocates
+  const std::size_t workers = std::min<std::size_t>(std::max(1, cv::getNumThreads()), count);
+  if (workspaces.size() < workers) {
+    workspaces.resize(workers);
+  }
+  const std::size_t longest = batch.maxLength();
+  for (std::size_t w = 0; w < workers; w++) {
+    workspaces[w].reserve(degree, longest, method);
+  }
+
+  cv::parallel_for_(cv::Range(0, (int)workers), [&](const cv::Range &range) {
+    for (int w = range.start; w < range.end; w++) {
+      PolyFitWorkspace &ws = workspaces[w];
+      const std::size_t first = count * w / workers;
+      const std::size_t last = count * (w + 1) / workers;
+
+      for (std::size_t s = first; s < last; s++) {
+        const std::size_t begin = batch.offsets[s];
+        const std::size_t m = batch.length(s);
+        const double *xs = batch.xs.data() + begin;
+        const double *ys = batch.ys.data() + begin;
+        double *c = results.coefficients.data() + s * n;
+
+        if (m < (std::size_t)n) {
+          std::fill(c, c + n, 0.0);
+          results.rms[s] = 0.0;
+          results.valid[s] = 0;
+          continue;
+        }
+
+        // Center and scale x to keep the Vandermonde columns well conditioned
+        double minX = xs[0], maxX = xs[0];
+        for (std::size_t i = 1; i < m; i++) {
+          minX = std::min(minX, xs[i]);
+          maxX = std::max(maxX, xs[i]);
+        }
+        double shift = 0.5 * (minX + maxX);
+        double scale = 0.5 * (maxX - minX);
+        if (scale == 0.0) {
+          scale = 1.0;
+        }
+
+        double rss = method == PolyFitMethod::HOUSEHOLDER_QR
+          ? fitSeriesQR(xs, ys, m, degree, shift, scale, ws, c)
+          : fitSeriesCholesky(xs, ys, m, degree, shift, scale, c);
+
+        if (rss < 0.0) {
+          std::fill(c, c + n, 0.0);
+          results.rms[s] = 0.0;
+          results.valid[s] = 0;
+          continue;
+        }
+
+        denormalizeCoefficients(c, degree, shift, scale);
+        results.rms[s] = std::sqrt(rss / m);
+        results.valid[s] = 1;
+      }
+    }
+  }, (double)workers);
+}
@@ -0,0 +1,72 @@
+#ifndef __POLY_FIT_H__
+#define __POLY_FIT_H__
+
+#include "opencv2/opencv.hpp"
+#include <cstddef>
+#include <vector>
+
+// Highest supported polynomial degree. Fits are small and dense, so the
+// per-series scratch is bounded by (kMaxPolyDegree + 1) columns.
+constexpr int kMaxPolyDegree = 8;
+
+enum class PolyFitMethod {
+  HOUSEHOLDER_QR, // orthogonal factorization of the design matrix, best conditioned
+  CHOLESKY,       // normal equations (Gram matrix), streams the points once
+};
+
+// Many short point series packed back to back in one SoA buffer.
+// Series i occupies [offsets[i], offsets[i + 1]) of xs / ys.
+struct PointSeriesBatch {
+  std::vector<double> xs;
+  std::vector<double> ys;
+  std::vector<std::size_t> offsets{ 0 };
+
+  void reserve(std::size_t seriesCount, std::size_t pointCount);
+  void addSeries(const std::vector<cv::Point2d> &points);
+  void clear();
+
+  std::size_t size() const { return offsets.size() - 1; }
+  std::size_t length(std::size_t series) const { return offsets[series + 1] - offsets[series]; }
+  std::size_t maxLength() const;
+};
+
+// Output of a batched fit, also flat: series i owns coefficients
+// [i * (degree + 1), (i + 1) * (degree + 1)), lowest power first.
+struct PolyFitResults {
+  int degree = 0;
+  std::vector<double> coefficients;
+  std::vector<double> rms;  // root mean square residual per series
+  // 0 when the series was too short or rank deficient, and for every series
+  // when the degree is outside [0, kMaxPolyDegree], which leaves no coefficients
+  std::vector<uchar> valid;
+
+  const double *coefficientsOf(std::size_t series) const { return &coefficients[series * (degree + 1)]; }
+};
+
+// Scratch memory for fitting one series at a time. Sized for the longest
+// series of a batch and reused for every series handled by one worker.
+struct PolyFitWorkspace {
+  std::vector<double> design; // column-major m x (degree + 1), QR only
+  std::vector<double> rhs;    // m, QR only
+
+  void reserve(int degree, std::size_t maxPoints, PolyFitMethod method);
+};
+
+// Fits y = c0 + c1 x + ... + ck x^k to every series of a batch, in parallel
+// over series. Workspaces and result buffers are kept between calls, so
+// fitting batches of a similar shape repeatedly does not allocate.
+class BatchPolyFitter {
+  int degree;
+  PolyFitMethod method;
+  std::vector<PolyFitWorkspace> workspaces;
+
+public:
+  BatchPolyFitter(int degree, PolyFitMethod method = PolyFitMethod::HOUSEHOLDER_QR);
+
+  void fit(const PointSeriesBatch &batch, PolyFitResults &results);
+};
+
+// Evaluates a polynomial with lowest power first (Horner).
+double evaluatePolynomial(const double *coefficients, int degree, double x);
+
+#endif // __POLY_FIT_H__
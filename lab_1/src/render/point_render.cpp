@@ -0,0 +1,148 @@
+#include "point_render.h"
+#include "../common/logger/logger.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Number of workers used for one pass over the points. Small inputs are not
+// worth splitting.
+static int workerCount(std::size_t n)
+{
+  const std::size_t minPerWorker = 1 << 16;
+  std::size_t workers = std::min<std::size_t>(std::max(1, cv::getNumThreads()), n / minPerWorker);
+  return (int)std::max<std::size_t>(1, workers);
+}
+
+PointBounds computePointBounds(const std::vector<cv::Point2d> &points)
+{
+  const std::size_t n = points.size();
+  const int workers = workerCount(n);
+  std::vector<PointBounds> partial(workers);
+
+  cv::parallel_for_(cv::Range(0, workers), [&](const cv::Range &range) {
+    for (int w = range.start; w < range.end; w++) {
+      PointBounds b;
+      for (std::size_t i = n * w / workers; i < n * (w + 1) / workers; i++) {
+        b.add(points[i].x, points[i].y);
+      }
+      partial[w] = b;
+    }
+  }, workers);
+
+  PointBounds total;
+  for (const PointBounds &b : partial) {
+    total.add(b);
+  }
+  return total;
+}
+
+PlotFrame computePlotFrame(const PointBounds &bounds, int W, int H, int pad)
+{
+  PlotFrame frame;
+  frame.W = W;
+  frame.H = H;
+  frame.pad = pad;
+
+  double spanX = bounds.maxX - bounds.minX;
+  double spanY = bounds.maxY - bounds.minY;
+  if (spanX == 0) spanX = 1;
+  if (spanY == 0) spanY = 1;
+
+  double scaleX = (W - 2.0 * pad) / spanX;
+  double scaleY = (H - 2.0 * pad) / spanY;
+
+  frame.minX = bounds.minX;
+  frame.minY = bounds.minY;
+  frame.scale = std::min(scaleX, scaleY);
+
+  return frame;
+}
+
+PlotFrame computePlotFrame(const std::vector<cv::Point2d> &points, int W, int H, int pad)
+{
+  return computePlotFrame(computePointBounds(points), W, H, pad);
+}
+
+cv::Mat_<int> binPointDensity(const std::vector<cv::Point2d> &points, const PlotFrame &frame)
+{
+  const int W = frame.W, H = frame.H;
+  const std::size_t n = points.size();
+  const int workers = workerCount(n);
+
+  // Private histograms avoid atomics in the hot loop; worker 0 bins straight
+  // into the result
+  cv::Mat_<int> density = cv::Mat_<int>::zeros(H, W);
+  std::vector<std::vector<int>> partial(workers - 1);
+
+  cv::parallel_for_(cv::Range(0, workers), [&](const cv::Range &range) {
+    for (int w = range.start; w < range.end; w++) {
+      int *hist;
+      if (w == 0) {
+        hist = density.ptr<int>(0);
+      }
+      else {
+        partial[w - 1].assign((std::size_t)W * H, 0);
+        hist = partial[w - 1].data();
+      }
+
+      const double offsetX = frame.pad - frame.minX * frame.scale;
+      const double offsetY = H - frame.pad + frame.minY * frame.scale;
+
+      for (std::size_t i = n * w / workers; i < n * (w + 1) / workers; i++) {
+        int x = (int)(offsetX + points[i].x * frame.scale);
+        int y = (int)(offsetY - points[i].y * frame.scale);
+        if ((unsigned)x < (unsigned)W && (unsigned)y < (unsigned)H) {
+          hist[y * W + x]++;
+        }
+      }
+    }
+  }, workers);
+
+  if (workers > 1) {
+    cv::parallel_for_(cv::Range(0, H), [&](const cv::Range &rows) {
+      for (int y = rows.start; y < rows.end; y++) {
+        int *dst = density.ptr<int>(y);
+        for (const std::vector<int> &hist : partial) {
+          const int *src = hist.data() + (std::size_t)y * W;
+          for (int x = 0; x < W; x++) {
+            dst[x] += src[x];
+          }
+        }
+      }
+    });
+  }
+
+  return density;
+}
+
+cv::Mat renderDensity(const cv::Mat_<int> &density, const PointRenderOptions &options)
+{
+  double maxDensity = 0;
+  cv::minMaxLoc(density, nullptr, &maxDensity);
+
+  cv::Mat_<uchar> intensity(density.rows, density.cols);
+  const double norm = options.toneMap == DensityToneMap::LOG
+    ? 1.0 / std::log1p(std::max(1.0, maxDensity))
+    : 1.0 / std::max(1.0, maxDensity);
+
+  cv::parallel_for_(cv::Range(0, density.rows), [&](const cv::Range &rows) {
+    for (int y = rows.start; y < rows.end; y++) {
+      const int *src = density.ptr<int>(y);
+      uchar *dst = intensity.ptr<uchar>(y);
+      for (int x = 0; x < density.cols; x++) {
+        double v = options.toneMap == DensityToneMap::LOG ? std::log1p((double)src[x]) : (double)src[x];
+        dst[x] = cv::saturate_cast<uchar>(255.0 * v * norm);
+      }
+    }
+  });
+
+  if (!options.useColorMap) {
+    // Match the cross renderer: white background, dense areas dark
+    return 255 - intensity;
+  }
+
+  cv::Mat colored;
+  cv::applyColorMap(intensity, colored, options.colorMap);
+  colored.setTo(cv::Scalar(255, 255, 255), density == 0);
+  return colored;
+}
@@ -0,0 +1,75 @@
+#ifndef __POINT_RENDER_H__
+#define __POINT_RENDER_H__
+
+#include "opencv2/opencv.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+// Bounding box of a point set, empty until a point is added
+struct PointBounds {
+  double minX = std::numeric_limits<double>::max();
+  double minY = std::numeric_limits<double>::max();
+  double maxX = std::numeric_limits<double>::lowest();
+  double maxY = std::numeric_limits<double>::lowest();
+
+  void add(double x, double y)
+  {
+    minX = std::min(minX, x);
+    minY = std::min(minY, y);
+    maxX = std::max(maxX, x);
+    maxY = std::max(maxY, y);
+  }
+
+  void add(const PointBounds &other)
+  {
+    minX = std::min(minX, other.minX);
+    minY = std::min(minY, other.minY);
+    maxX = std::max(maxX, other.maxX);
+    maxY = std::max(maxY, other.maxY);
+  }
+};
+
+// Maps point coordinates onto a W x H canvas with a uniform scale and y pointing up
+struct PlotFrame {
+  int W = 500, H = 500, pad = 20;
+  double minX = 0, minY = 0, scale = 1;
+
+  cv::Point toCanvas(double x, double y) const
+  {
+    return cv::Point((int)(pad + (x - minX) * scale), (int)(H - pad - (y - minY) * scale)); // flip y
+  }
+};
+
+enum class DensityToneMap {
+  LINEAR,
+  LOG, // keeps sparse regions visible next to dense clusters
+};
+
+struct PointRenderOptions {
+  // Level of detail: up to this many points are drawn as individual crosses,
+  // beyond it the canvas shows the point density instead
+  std::size_t crossLimit = 20000;
+  DensityToneMap toneMap = DensityToneMap::LOG;
+  bool useColorMap = false;
+  int colorMap = cv::COLORMAP_INFERNO;
+};
+
+// Bounds of the point set, reduced in parallel
+PointBounds computePointBounds(const std::vector<cv::Point2d> &points);
+
+// Frame fitting the bounds onto the canvas. Callers that already know the
+// bounds, e.g. from reading the points, save a pass over them.
+PlotFrame computePlotFrame(const PointBounds &bounds, int W = 500, int H = 500, int pad = 20);
+PlotFrame computePlotFrame(const std::vector<cv::Point2d> &points, int W = 500, int H = 500, int pad = 20);
+
+// Counts the points falling into every canvas pixel. Each worker bins its
+// share of the points into a private integer histogram, which are then summed.
+cv::Mat_<int> binPointDensity(const std::vector<cv::Point2d> &points, const PlotFrame &frame);
+
+// Tone-maps a density histogram to an 8-bit grayscale (dark = dense) or color
+// image. Empty pixels stay white in both cases.
+cv::Mat renderDensity(const cv::Mat_<int> &density, const PointRenderOptions &options);
+
+#endif // __POINT_RENDER_H__
@@ -48,25 +48,30 @@ int main() {
 vector<Dataset> build_data_set(Mat img) {
     vector<Dataset> result;
 
-    for (int i = 0; i < img.rows; i++) {
-        for (int j = 0; j < img.cols; j++) {
-            Vec3b pixel = img.at<Vec3b>(i, j);
-            Dataset d;
-
-            // Red pixel
-            if (pixel[2] > 200 && pixel[0] < 50 && pixel[1] < 50) {
-                d.x = (Mat_<double>(1, 3) << 1.0, (double)j, (double)i); // [1, col, row]
-                d.y = 1;
-                result.push_back(d);
-            }
-
-            // Blue pixel
-            else if (pixel[0] > 200 && pixel[2] < 50 && pixel[1] < 50) {
-                d.x = (Mat_<double>(1, 3) << 1.0, (double)j, (double)i); // [1, col, row]
-                d.y = -1;
-                result.push_back(d);
-            }
+    // Red pixels (R > 200, G < 50, B < 50) are class +1 and blue ones
+    // (B > 200, G < 50, R < 50) class -1, channels in BGR order
+    PointCoordinates<double> red = extractPoints<double>(img, PixelPredicate::inRange(Scalar(0, 0, 201), Scalar(49, 49, 255)));
+    PointCoordinates<double> blue = extractPoints<double>(img, PixelPredicate::inRange(Scalar(201, 0, 0), Scalar(255, 49, 49)));
+
+    // Merge both row-major lists so the online perceptron still sees the
+    // pixels in scan order
+    size_t r = 0, b = 0;
+    while (r < red.size() || b < blue.size()) {
+        bool takeRed = b == blue.size() ||
+            (r < red.size() && (red.y[r] < blue.y[b] || (red.y[r] == blue.y[b] && red.x[r] < blue.x[b])));
+
+        Dataset d;
+        if (takeRed) {
+            d.x = (Mat_<double>(1, 3) << 1.0, red.x[r], red.y[r]); // [1, col, row]
+            d.y = 1;
+            r++;
+        }
+        else {
+            d.x = (Mat_<double>(1, 3) << 1.0, blue.x[b], blue.y[b]); // [1, col, row]
+            d.y = -1;
+            b++;
         }
+        result.push_back(d);
     }
 
     return result;
@@ -0,0 +1,48 @@
+#ifndef __POINT_EXTRACTOR_H__
+#define __POINT_EXTRACTOR_H__
+
+#include "opencv2/opencv.hpp"
+#include <cstddef>
+#include <vector>
+
+// Which pixels of an 8-bit image become points: those whose channels c are
+// all within [low[c], high[c]], or with negate, all the other ones
+struct PixelPredicate {
+  uchar low[4] = { 0, 0, 0, 0 };
+  uchar high[4] = { 255, 255, 255, 255 };
+  bool negate = false;
+
+  // Every channel equal to value, e.g. black points of a binary image
+  static PixelPredicate equal(uchar value);
+  static PixelPredicate notEqual(uchar value);
+  // Channel ranges in image order (BGR for color images), bounds included
+  static PixelPredicate inRange(const cv::Scalar &low, const cv::Scalar &high);
+};
+
+// Coordinates of the matching pixels in structure-of-arrays layout, in
+// row-major order: x is the column, y the row
+template <typename T>
+struct PointCoordinates {
+  std::vector<T> x;
+  std::vector<T> y;
+
+  std::size_t size() const { return x.size(); }
+  bool empty() const { return x.empty(); }
+};
+
+// Number of pixels of an 8-bit image with up to 4 channels matching the
+// predicate. Rows are scanned 16 or 32 pixels at a time with a vector compare
+// and a movemask, in parallel over row bands.
+std::size_t countPoints(const cv::Mat &img, const PixelPredicate &predicate);
+
+// Writes the coordinates of the matching pixels to xs and ys, which must hold
+// countPoints() values, and returns their number. A first pass counts every
+// row, so the second one writes each band straight to its final offset.
+// Instantiated for int, float and double.
+template <typename T>
+std::size_t extractPoints(const cv::Mat &img, const PixelPredicate &predicate, T *xs, T *ys);
+
+template <typename T>
+PointCoordinates<T> extractPoints(const cv::Mat &img, const PixelPredicate &predicate);
+
+#endif // __POINT_EXTRACTOR_H__
@@ -4,12 +4,18 @@
 #include "src/common/common.h"
 #include "src/slider/slider.h"
 #include "src/common/logger/logger.h"
+#include "src/ransac/ransac.h"
+#include "src/ransac/multi_line.h"
+#include "src/ransac/preemptive.h"
+#include "src/ransac/models.h"
 
 using namespace cv;
 using namespace std;
 
-vector<int> ransac_algorithm(int s, vector<Point2d> points, double t, int T, int N);
-Mat_<uchar> draw_line(Mat_<uchar> input_image, vector<int> params);
+vector<int> ransac_algorithm(int s, const PointSet& points, double t, int T, int N);
+Mat_<uchar> draw_line(Mat_<uchar> input_image, LineModel line);
+RansacFit<Plane3dModel> fit_synthetic_plane(const RansacOptions &options, double t, double p);
+bool check_masked_run(const PointSet &points, double t, int T, int N, RansacOptions options);
 
 int main() {
     srand(time(nullptr));
@@ -18,15 +24,12 @@ int main() {
     // the positions of all black points
     Mat_<uchar> input_image = imread("assets/points_RANSAC/points1.bmp", IMREAD_GRAYSCALE);
 
-    vector<Point2d> points;
-
-    for (int i = 0; i < input_image.rows; i++) {
-        for (int j = 0; j < input_image.cols; j++) {
-            if (input_image(i, j) == 0) {
-                points.push_back(Point2d(j, i));
-            }
-        }
-    }
+    // The extractor writes straight into the aligned x and y arrays of the
+    // point set every RANSAC variant runs on
+    PixelPredicate black = PixelPredicate::equal(0);
+    PointSet points;
+    points.resize(countPoints(input_image, black));
+    extractPoints<double>(input_image, black, points.x(), points.y());
 
     // 2 and 3. Calculate the parameters 𝑁 and 𝑇 starting from the recommended values:
     // t = 10, p = 0.99, q = 0.7 and s = 2. For points1.bmp use q = 0.3
@@ -41,19 +44,122 @@ int main() {
     cout << "N = " << N << endl;
     cout << "T = " << T << endl;
 
-    // 4. Apply the RANSAC method
-    vector<int> params = ransac_algorithm(s, points, t, T, N);
+    // 4. Apply the RANSAC method, either the reference single-threaded loop or
+    // the parallel one, which is reproducible for a given seed. multi_line
+    // keeps extracting lines from the points left over by the previous ones,
+    // preemptive scores a fixed batch of hypotheses in bounded time. generic
+    // runs the Ransac<Model> engine instead, for the line and for a circle
+    // through the same points, and for a plane in a synthetic 3D point cloud.
+    // check compares a masked run with a run over a copy of the same points;
+    // build with -DPRSLAB2_SANITIZE=ON to have it catch memory errors too.
+    bool parallel = true;
+    bool check = false;
+    bool multi_line = false;
+    bool preemptive = false;
+    bool generic = false;
+    vector<LineModel> lines;
+    vector<Circle2dModel::Params> circles;
+
+    if (parallel) {
+        RansacOptions options;
+        options.seed = 12345;
+        // With q = 0.3 most hypotheses are bad, so reject them early with SPRT
+        options.verification = Verification::SPRT;
+        options.sprt_epsilon = q;
+        // N from the guessed q is only an upper bound: stop as soon as the best
+        // line found so far makes more hypotheses pointless, and refit it to
+        // its inliers for sub-pixel parameters
+        options.adaptive = true;
+        options.confidence = p;
+        options.lo_iterations = 3;
+        // Points on the line are each other's neighbors in the image, so draw
+        // the second point of a sample near the first one
+        options.sampling = Sampling::NAPSAC;
+
+        if (check) {
+            bool same = check_masked_run(points, t, T, N, options);
+            cout << "Masked run " << (same ? "matches" : "differs from") << " the run over the copied points" << endl;
+            return same ? 0 : 1;
+        }
+
+        if (generic) {
+            // The engine samples uniformly and counts every point, so only
+            // the seed, adaptive termination and the refits carry over
+            PointTable<2> table(points.size());
+            for (size_t k = 0; k < points.size(); k++) {
+                table.col(0)[k] = points.x()[k];
+                table.col(1)[k] = points.y()[k];
+            }
+
+            RansacFit<Line2dModel> line = Ransac<Line2dModel>(options).run(table, t, T, N);
+            cout << "Best hypothesis = " << line.hypothesis << " with " << line.inliers << " inliers" << endl;
+            cout << "Iterations needed = " << line.iterations << " of " << N << endl;
+            cout << "Line: " << line.params.a << " x + " << line.params.b << " y + " << line.params.c << " = 0" << endl;
+            if (line.found) {
+                lines.push_back(line.params);
+            }
+
+            // Three points per sample need more hypotheses for the same q
+            int N3 = log(1.0 - p) / log(1.0 - pow(q, 3));
+            RansacFit<Circle2dModel> circle = Ransac<Circle2dModel>(options).run(table, t, T, N3);
+            cout << "Circle: center (" << circle.params.cx << ", " << circle.params.cy << "), radius "
+                 << circle.params.r << " with " << circle.inliers << " inliers" << endl;
+            if (circle.found) {
+                circles.push_back(circle.params);
+            }
+
+            RansacFit<Plane3dModel> plane = fit_synthetic_plane(options, 0.5, p);
+            cout << "Plane: " << plane.params.a << " x + " << plane.params.b << " y + " << plane.params.c << " z + "
+                 << plane.params.d << " = 0 with " << plane.inliers << " inliers" << endl;
+        }
+
+        else if (multi_line) {
+            vector<LineDetection> detections = ransac_multi_line(points, t, T, N, options);
+
+            for (const LineDetection &detection : detections) {
+                cout << "Line: " << detection.line.a << " x + " << detection.line.b << " y + " << detection.line.c
+                     << " = 0 with " << detection.inliers << " inliers" << endl;
+                lines.push_back(detection.line);
+            }
+        }
+
+        else {
+            RansacResult ransac = preemptive ? ransac_preemptive(points, t, N, options)
+                                             : ransac_parallel(points, t, T, N, options);
+
+            cout << "Best hypothesis = " << ransac.hypothesis << " with " << ransac.inliers << " inliers, "
+                 << ransac.evaluated << " hypotheses evaluated, " << ransac.point_tests << " point tests" << endl;
+            cout << "Iterations needed = " << ransac.iterations << " of " << N << endl;
+            cout << "Line: " << ransac.line.a << " x + " << ransac.line.b << " y + " << ransac.line.c << " = 0" << endl;
+
+            lines.push_back(ransac.line);
+        }
+    }
+
+    else {
+        vector<int> params = ransac_algorithm(s, points, t, T, N);
+        lines.push_back({ (double)params[0], (double)params[1], (double)params[2] });
+    }
 
     // 7. Draw the optimal line found by the method
+    Mat_<uchar> result = input_image;
+    for (const LineModel &line : lines) {
+        result = draw_line(result, line);
+    }
+    for (const Circle2dModel::Params &circle : circles) {
+        cv::circle(result, Point(cvRound(circle.cx), cvRound(circle.cy)), cvRound(circle.r), Scalar(0, 0, 255), 1,
+                   LINE_AA);
+    }
+
     namedWindow("RANSAC Algorithm", WINDOW_KEEPRATIO);
-    imshow("RANSAC Algorithm", draw_line(input_image, params));
+    imshow("RANSAC Algorithm", result);
 
     waitKey(0);
 
     return 0;
 }
 
-vector<int> ransac_algorithm(int s, vector<Point2d> points, double t, int T, int N) {
+vector<int> ransac_algorithm(int s, const PointSet& points, double t, int T, int N) {
     vector<int> result(3, 0);
 
     if (points.size() < 2) {
@@ -127,19 +233,106 @@ vector<int> ransac_algorithm(int s, vector<Point2d> points, double t, int T, int
     return result;
 }
 
-Mat_<uchar> draw_line(Mat_<uchar> input_image, vector<int> params) {
+// Plane 0.2 x - 0.1 y - z + 5 = 0 sampled over [0, 100)^2 with Gaussian noise
+// of deviation 0.1 along z, mixed with 40% of points anywhere in the cube
+RansacFit<Plane3dModel> fit_synthetic_plane(const RansacOptions &options, double t, double p) {
+    const int count = 2000;
+    const double q = 0.6;
+    RNG rng(options.seed);
+
+    PointTable<3> cloud(count);
+    for (int k = 0; k < count; k++) {
+        double x = rng.uniform(0.0, 100.0);
+        double y = rng.uniform(0.0, 100.0);
+        double z = k < q * count ? 0.2 * x - 0.1 * y + 5.0 + rng.gaussian(0.1) : rng.uniform(-20.0, 30.0);
+
+        cloud.col(0)[k] = x;
+        cloud.col(1)[k] = y;
+        cloud.col(2)[k] = z;
+    }
+
+    int N = log(1.0 - p) / log(1.0 - pow(q, 3));
+    int T = q * count;
+    return Ransac<Plane3dModel>(options).run(cloud, t, T, N);
+}
+
+// Runs ransac_parallel over the points a first line leaves, once through an
+// active mask and once over a copy of just those points, with every sampler.
+// Active points are numbered by rank, so both runs draw the same samples and
+// must find the same line.
+bool check_masked_run(const PointSet &points, double t, int T, int N, RansacOptions options) {
+    // Refits would sum the points in a different order with and without the mask
+    options.lo_iterations = 0;
+
+    RansacResult first = ransac_parallel(points, t, T, N, options);
+    if (!first.found) {
+        return false;
+    }
+
+    const LineModel &line = first.line;
+    double bound = t * sqrt(line.a * line.a + line.b * line.b);
+
+    ConsensusMask rest(points.size(), false);
+    vector<Point2d> kept;
+    for (size_t i = 0; i < points.size(); i++) {
+        if (!(abs(line.a * points.x()[i] + line.b * points.y()[i] + line.c) <= bound)) {
+            rest.set(i);
+            kept.push_back(points[i]);
+        }
+    }
+
+    // PROSAC and NAPSAC reach the points through the mask as well, NAPSAC
+    // also when it builds its neighbor grid
+    PointSet copy(kept);
+    for (Sampling sampling : { Sampling::UNIFORM, Sampling::PROSAC, Sampling::NAPSAC }) {
+        options.sampling = sampling;
+        RansacResult masked = ransac_parallel(points, t, T, N, options, &rest);
+        RansacResult copied = ransac_parallel(copy, t, T, N, options);
+
+        if (masked.hypothesis != copied.hypothesis || masked.inliers != copied.inliers ||
+            masked.iterations != copied.iterations || masked.line.a != copied.line.a ||
+            masked.line.b != copied.line.b || masked.line.c != copied.line.c) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+Mat_<uchar> draw_line(Mat_<uchar> input_image, LineModel params) {
     Mat_<uchar> result = input_image.clone();
 
-    int a = params[0];
-    int b = params[1];
-    int c = params[2];
+    double a = params.a;
+    double b = params.b;
+    double c = params.c;
+
+    if (a == 0.0 && b == 0.0) {
+        return result;
+    }
+
+    double W = input_image.cols - 1;
+    double H = input_image.rows - 1;
+
+    // Intersect with the left and right borders, or with the top and bottom
+    // ones for lines closer to vertical
+    Point2d p1, p2;
 
-    int W = input_image.cols - 1;
+    if (abs(b) >= abs(a)) {
+        p1 = Point2d(0, -c / b);
+        p2 = Point2d(W, (-a * W - c) / b);
+    }
+
+    else {
+        p1 = Point2d(-c / a, 0);
+        p2 = Point2d((-b * H - c) / a, H);
+    }
 
-    Point2d p1(0, -c / b);
-    Point2d p2(W, (-a * W - c) / b);
+    // Keep the sub-pixel endpoints with 4 fractional bits
+    const int shift = 4;
+    Point q1(cvRound(p1.x * (1 << shift)), cvRound(p1.y * (1 << shift)));
+    Point q2(cvRound(p2.x * (1 << shift)), cvRound(p2.y * (1 << shift)));
 
-    line(result, p1, p2, Scalar(0, 0, 255));
+    line(result, q1, q2, Scalar(0, 0, 255), 1, LINE_AA, shift);
 
     return result;
 }
@@ -0,0 +1,66 @@
+#include "consensus_mask.h"
+
+#include <algorithm>
+
+ConsensusMask::ConsensusMask(std::size_t n, bool value)
+{
+  assign(n, value);
+}
+
+void ConsensusMask::assign(std::size_t n, bool value)
+{
+  count = n;
+  words.assign((n + 63) / 64, value ? ~0ull : 0ull);
+  if (value && n % 64 != 0) {
+    words.back() = (1ull << (n % 64)) - 1;
+  }
+}
+
+void ConsensusMask::set(std::size_t i, bool value)
+{
+  uint64_t bit = 1ull << (i % 64);
+  if (value) {
+    words[i / 64] |= bit;
+  }
+  else {
+    words[i / 64] &= ~bit;
+  }
+}
+
+std::size_t ConsensusMask::popcount() const
+{
+  std::size_t total = 0;
+  for (uint64_t word : words) {
+    total += __builtin_popcountll(word);
+  }
+  return total;
+}
+
+void ConsensusMask::subtract(const ConsensusMask &other)
+{
+  std::size_t n = std::min(words.size(), other.words.size());
+  for (std::size_t w = 0; w < n; w++) {
+    words[w] &= ~other.words[w];
+  }
+}
+
+MaskSelector::MaskSelector(const ConsensusMask &mask)
+  :words(mask.data()), before(mask.word_count())
+{
+  for (std::size_t w = 0; w < before.size(); w++) {
+    before[w] = (uint32_t)total;
+    total += __builtin_popcountll(words[w]);
+  }
+}
+
+std::size_t MaskSelector::select(std::size_t k) const
+{
+  // Last word with fewer than k + 1 set bits before it
+  std::size_t w = std::upper_bound(before.begin(), before.end(), (uint32_t)k) - before.begin() - 1;
+
+  uint64_t word = words[w];
+  for (std::size_t r = k - before[w]; r > 0; r--) {
+    word &= word - 1;
+  }
+  return w * 64 + __builtin_ctzll(word);
+}
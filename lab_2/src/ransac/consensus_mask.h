@@ -0,0 +1,54 @@
+#ifndef __CONSENSUS_MASK_H__
+#define __CONSENSUS_MASK_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// One bit per point of a PointSet, packed 64 points to a word: bit i % 64 of
+// word i / 64 stands for point i. Bits past size() are always clear, so set
+// operations and popcounts can work on whole words.
+class ConsensusMask {
+  std::vector<uint64_t> words;
+  std::size_t count = 0;
+
+public:
+  ConsensusMask() = default;
+  explicit ConsensusMask(std::size_t n, bool value = false);
+
+  void assign(std::size_t n, bool value);
+
+  std::size_t size() const { return count; }
+  std::size_t word_count() const { return words.size(); }
+
+  uint64_t *data() { return words.data(); }
+  const uint64_t *data() const { return words.data(); }
+
+  bool test(std::size_t i) const { return (words[i / 64] >> (i % 64)) & 1; }
+  void set(std::size_t i, bool value = true);
+
+  // Number of set bits
+  std::size_t popcount() const;
+  // Clears every bit set in other: this &= ~other
+  void subtract(const ConsensusMask &other);
+};
+
+// Rank table over a mask, to pick the k-th set bit in O(log(n / 64)) without
+// listing the set points. The selector reads the words of the mask, which
+// must outlive it, so it cannot be built from a temporary.
+class MaskSelector {
+  const uint64_t *words = nullptr;
+  std::vector<uint32_t> before; // set bits in the words before each word
+  std::size_t total = 0;
+
+public:
+  MaskSelector() = default; // over no points
+  explicit MaskSelector(const ConsensusMask &mask);
+  MaskSelector(ConsensusMask &&) = delete;
+
+  std::size_t size() const { return total; }
+  // Index of the k-th set bit, k < size()
+  std::size_t select(std::size_t k) const;
+};
+
+#endif // __CONSENSUS_MASK_H__
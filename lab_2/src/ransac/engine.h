@@ -0,0 +1,308 @@
+#ifndef __RANSAC_ENGINE_H__
+#define __RANSAC_ENGINE_H__
+
+#include "opencv2/opencv.hpp"
+#include "point_set.h"
+#include "philox.h"
+#include "ransac.h"
+#include "inlier_kernel.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// Rows of Dims coordinates in structure-of-arrays layout: one aligned column
+// per coordinate, padded to a multiple of kLanes with NaN like PointSet
+template <int Dims>
+class PointTable {
+public:
+  static constexpr int kDims = Dims;
+
+private:
+  std::array<PointSet::Buffer, Dims> columns;
+  std::size_t count = 0;
+
+public:
+  PointTable() = default;
+  explicit PointTable(std::size_t n) { resize(n); }
+
+  // Makes room for n rows; the caller fills the columns
+  void resize(std::size_t n)
+  {
+    const std::size_t padded = (n + PointSet::kLanes - 1) / PointSet::kLanes * PointSet::kLanes;
+    count = n;
+    for (PointSet::Buffer &column : columns) {
+      column.resize(padded);
+      std::fill(column.begin() + n, column.end(), std::numeric_limits<double>::quiet_NaN());
+    }
+  }
+
+  std::size_t size() const { return count; }
+  std::size_t padded_size() const { return columns[0].size(); }
+
+  double *col(int d) { return columns[d].data(); }
+  const double *col(int d) const { return columns[d].data(); }
+  double at(std::size_t i, int d) const { return columns[d][i]; }
+};
+
+// Samplers pick k distinct row indices below n from the hypothesis stream
+
+// Every row equally likely
+struct UniformSampler {
+  static void sample(Philox4x32 &rng, uint32_t n, uint32_t *indices, int k)
+  {
+    for (int j = 0; j < k; j++) {
+      uint32_t i;
+      do {
+        i = rng.uniform(n);
+      } while (std::find(indices, indices + j, i) != indices + j);
+      indices[j] = i;
+    }
+  }
+};
+
+// Rows whose residual under the kernel is at most t2, over [from, to). Kernels
+// are inline and branch-free, so the loop vectorizes for every model.
+template <typename Kernel, int Dims>
+__attribute__((always_inline)) inline int count_rows(const double *const *cols, const Kernel &kernel, double t2,
+                                                     std::size_t from, std::size_t to)
+{
+  int count = 0;
+#pragma omp simd reduction(+ : count)
+  for (std::size_t i = from; i < to; i++) {
+    count += kernel(cols, i) <= t2;
+  }
+  return count;
+}
+
+template <typename Kernel, int Dims>
+int count_rows_default(const double *const *cols, const Kernel &kernel, double t2, std::size_t from, std::size_t to)
+{
+  return count_rows<Kernel, Dims>(cols, kernel, t2, from, to);
+}
+
+// Same loop compiled for AVX2, without FMA so that residuals round the same way
+template <typename Kernel, int Dims>
+__attribute__((target("avx2")))
+int count_rows_avx2(const double *const *cols, const Kernel &kernel, double t2, std::size_t from, std::size_t to)
+{
+  return count_rows<Kernel, Dims>(cols, kernel, t2, from, to);
+}
+
+template <typename Kernel, int Dims>
+inline int count_within(const PointTable<Dims> &points, const Kernel &kernel, double t2, std::size_t from, std::size_t to)
+{
+  const double *cols[Dims];
+  for (int d = 0; d < Dims; d++) {
+    cols[d] = points.col(d);
+  }
+
+  if (simd_level() != SimdLevel::SCALAR) {
+    return count_rows_avx2<Kernel, Dims>(cols, kernel, t2, from, to);
+  }
+  return count_rows_default<Kernel, Dims>(cols, kernel, t2, from, to);
+}
+
+// Verifiers score a hypothesis, returning -1 once it cannot reach bar
+
+// Every row, in blocks, dropping the hypothesis as soon as the rows left
+// cannot lift it to bar
+struct FullVerifier {
+  static constexpr std::size_t kBlock = 1024;
+
+  template <typename Kernel, int Dims>
+  static int verify(const PointTable<Dims> &points, const Kernel &kernel, double t2, Philox4x32 &, int bar)
+  {
+    const std::size_t n = points.size();
+    int inliers = 0;
+
+    for (std::size_t i = 0; i < n; i += kBlock) {
+      std::size_t end = std::min(n, i + kBlock);
+      inliers += count_within(points, kernel, t2, i, end);
+      if (inliers + (long long)(n - end) < bar) {
+        return -1;
+      }
+    }
+    return inliers;
+  }
+};
+
+// T(d,d) pre-test: d random rows must all be inliers before the full count
+template <int D>
+struct TddVerifier {
+  template <typename Kernel, int Dims>
+  static int verify(const PointTable<Dims> &points, const Kernel &kernel, double t2, Philox4x32 &rng, int bar)
+  {
+    const double *cols[Dims];
+    for (int d = 0; d < Dims; d++) {
+      cols[d] = points.col(d);
+    }
+
+    for (int k = 0; k < D; k++) {
+      if (!(kernel(cols, rng.uniform((uint32_t)points.size())) <= t2)) {
+        return -1;
+      }
+    }
+    return FullVerifier::verify(points, kernel, t2, rng, bar);
+  }
+};
+
+template <typename Model>
+struct RansacFit {
+  typename Model::Params params{};
+  int inliers = -1;
+  int hypothesis = -1;
+  int iterations = 0; // hypotheses the sequential loop would have needed
+  bool found = false;
+};
+
+// RANSAC over any model policy. A model supplies
+//   kDims, kSampleSize   row width and minimal sample size
+//   Params               the model parameters
+//   fit(points, sample, params)         model through kSampleSize rows
+//   Kernel(params), kernel(cols, i)     squared residual of row i, inline
+//   refine(points, params, t, refined)  least squares over the inliers
+// and the engine is instantiated, inlined and vectorized for it. Hypothesis h
+// uses Philox stream (seed, h) and workers take h = w, w + W, ... exactly like
+// ransac_parallel, so the result does not depend on the thread count. Of the
+// options, threads, seed, adaptive, confidence and lo_iterations (refinement
+// passes of the winner) apply.
+template <typename Model, typename Sampler = UniformSampler, typename Verifier = FullVerifier>
+class Ransac {
+public:
+  using Params = typename Model::Params;
+  using Points = PointTable<Model::kDims>;
+  static constexpr int kSampleSize = Model::kSampleSize;
+
+private:
+  RansacOptions options;
+
+  struct Improvement {
+    int hypothesis;
+    int inliers;
+    Params params;
+  };
+
+  int hypotheses_needed(int inliers, std::size_t n, int cap) const
+  {
+    double p = std::pow((double)inliers / n, kSampleSize);
+    if (p >= 1.0) {
+      return 1;
+    }
+    double miss = std::log(1.0 - p);
+    if (miss >= 0.0) {
+      return cap;
+    }
+    return (int)std::min<double>(cap, std::max(1.0, std::ceil(std::log(1.0 - options.confidence) / miss)));
+  }
+
+public:
+  explicit Ransac(const RansacOptions &options = {}) :options(options) {}
+
+  RansacFit<Model> run(const Points &points, double t, int T, int N) const
+  {
+    RansacFit<Model> result;
+    const std::size_t n = points.size();
+    const double t2 = t * t;
+
+    if (n < (std::size_t)kSampleSize || N <= 0) {
+      return result;
+    }
+
+    int workers = options.threads > 0 ? options.threads : cv::getNumThreads();
+    workers = std::max(1, std::min(workers, N));
+
+    std::atomic<int> last_needed(N - 1);
+    std::vector<std::vector<Improvement>> improvements(workers);
+
+    cv::parallel_for_(cv::Range(0, workers), [&](const cv::Range &range) {
+      for (int w = range.start; w < range.end; w++) {
+        std::vector<Improvement> &mine = improvements[w];
+
+        for (int h = w; h <= last_needed.load(std::memory_order_relaxed); h += workers) {
+          Philox4x32 rng(options.seed, (uint64_t)h);
+          uint32_t sample[kSampleSize];
+          Sampler::sample(rng, (uint32_t)n, sample, kSampleSize);
+
+          Params params;
+          if (!Model::fit(points, sample, params)) {
+            continue;
+          }
+
+          // A count below the worker's own best can neither win nor stop the
+          // run earlier, so the bail-out keeps the result exact
+          int bar = mine.empty() ? 0 : mine.back().inliers + 1;
+          int inliers = Verifier::verify(points, typename Model::Kernel(params), t2, rng, bar);
+          if (inliers < bar || inliers <= 0) {
+            continue;
+          }
+          mine.push_back({ h, inliers, params });
+
+          int last = inliers >= T ? h : options.adaptive
+            ? std::max(h, hypotheses_needed(inliers, n, N) - 1)
+            : N - 1;
+          int current = last_needed.load(std::memory_order_relaxed);
+          while (last < current && !last_needed.compare_exchange_weak(current, last, std::memory_order_relaxed)) {
+          }
+
+          if (inliers >= T) {
+            break;
+          }
+        }
+      }
+    }, workers);
+
+    // Best hypothesis up to the last one a sequential loop would have run,
+    // lowest index on ties
+    const int last = last_needed.load();
+    const Improvement *winner = nullptr;
+    for (const std::vector<Improvement> &mine : improvements) {
+      const Improvement *best = nullptr;
+      for (const Improvement &improvement : mine) {
+        if (improvement.hypothesis <= last) {
+          best = &improvement;
+        }
+      }
+      if (best != nullptr && (winner == nullptr || best->inliers > winner->inliers ||
+                              (best->inliers == winner->inliers && best->hypothesis < winner->hypothesis))) {
+        winner = best;
+      }
+    }
+
+    result.iterations = last + 1;
+    if (winner == nullptr) {
+      return result;
+    }
+
+    result.params = winner->params;
+    result.inliers = winner->inliers;
+    result.hypothesis = winner->hypothesis;
+    result.found = true;
+
+    // Least-squares refinement while the consensus set does not shrink
+    for (int i = 0; i < options.lo_iterations; i++) {
+      Params refined;
+      if (!Model::refine(points, result.params, t, refined)) {
+        break;
+      }
+      int inliers = count_within(points, typename Model::Kernel(refined), t2, 0, n);
+      if (inliers < result.inliers) {
+        break;
+      }
+      bool grew = inliers > result.inliers;
+      result.params = refined;
+      result.inliers = inliers;
+      if (!grew) {
+        break;
+      }
+    }
+
+    return result;
+  }
+};
+
+#endif // __RANSAC_ENGINE_H__
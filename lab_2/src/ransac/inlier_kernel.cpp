@@ -0,0 +1,373 @@
+#include "inlier_kernel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <immintrin.h>
+
+// The vector paths are compiled with per-function target attributes and picked
+// at runtime, so the binary still runs on machines without AVX2.
+
+static int count_inliers_scalar(const double *x, const double *y, std::size_t n, double a, double b, double c, double bound)
+{
+  int inliers = 0;
+  for (std::size_t i = 0; i < n; i++) {
+    inliers += std::abs(a * x[i] + b * y[i] + c) <= bound;
+  }
+  return inliers;
+}
+
+__attribute__((target("avx2,popcnt")))
+static int count_inliers_avx2(const double *x, const double *y, std::size_t n, double a, double b, double c, double bound)
+{
+  const __m256d va = _mm256_set1_pd(a);
+  const __m256d vb = _mm256_set1_pd(b);
+  const __m256d vc = _mm256_set1_pd(c);
+  const __m256d vbound = _mm256_set1_pd(bound);
+  const __m256d signMask = _mm256_set1_pd(-0.0);
+
+  // Two independent accumulators hide the compare latency
+  int inliers0 = 0, inliers1 = 0;
+  std::size_t i = 0;
+
+  for (; i + 8 <= n; i += 8) {
+    __m256d d0 = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(va, _mm256_loadu_pd(x + i)),
+                                             _mm256_mul_pd(vb, _mm256_loadu_pd(y + i))), vc);
+    __m256d d1 = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(va, _mm256_loadu_pd(x + i + 4)),
+                                             _mm256_mul_pd(vb, _mm256_loadu_pd(y + i + 4))), vc);
+    d0 = _mm256_andnot_pd(signMask, d0);
+    d1 = _mm256_andnot_pd(signMask, d1);
+    inliers0 += _mm_popcnt_u32(_mm256_movemask_pd(_mm256_cmp_pd(d0, vbound, _CMP_LE_OQ)));
+    inliers1 += _mm_popcnt_u32(_mm256_movemask_pd(_mm256_cmp_pd(d1, vbound, _CMP_LE_OQ)));
+  }
+
+  return inliers0 + inliers1 + count_inliers_scalar(x + i, y + i, n - i, a, b, c, bound);
+}
+
+__attribute__((target("avx512f,popcnt")))
+static int count_inliers_avx512(const double *x, const double *y, std::size_t n, double a, double b, double c, double bound)
+{
+  const __m512d va = _mm512_set1_pd(a);
+  const __m512d vb = _mm512_set1_pd(b);
+  const __m512d vc = _mm512_set1_pd(c);
+  const __m512d vbound = _mm512_set1_pd(bound);
+
+  int inliers0 = 0, inliers1 = 0;
+  std::size_t i = 0;
+
+  for (; i + 16 <= n; i += 16) {
+    __m512d d0 = _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(va, _mm512_loadu_pd(x + i)),
+                                             _mm512_mul_pd(vb, _mm512_loadu_pd(y + i))), vc);
+    __m512d d1 = _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(va, _mm512_loadu_pd(x + i + 8)),
+                                             _mm512_mul_pd(vb, _mm512_loadu_pd(y + i + 8))), vc);
+    inliers0 += _mm_popcnt_u32(_mm512_cmp_pd_mask(_mm512_abs_pd(d0), vbound, _CMP_LE_OQ));
+    inliers1 += _mm_popcnt_u32(_mm512_cmp_pd_mask(_mm512_abs_pd(d1), vbound, _CMP_LE_OQ));
+  }
+
+  // Fewer than 16 points left: masked loads, masked-off lanes are never counted
+  for (; i < n; i += 8) {
+    __mmask8 m = (__mmask8)((1u << std::min<std::size_t>(8, n - i)) - 1);
+    __m512d d = _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(va, _mm512_maskz_loadu_pd(m, x + i)),
+                                            _mm512_mul_pd(vb, _mm512_maskz_loadu_pd(m, y + i))), vc);
+    inliers0 += _mm_popcnt_u32(_mm512_mask_cmp_pd_mask(m, _mm512_abs_pd(d), vbound, _CMP_LE_OQ));
+  }
+
+  return inliers0 + inliers1;
+}
+
+// Inlier bits of up to 64 points starting at x, y
+static uint64_t inlier_word_scalar(const double *x, const double *y, std::size_t n, double a, double b, double c, double bound)
+{
+  uint64_t word = 0;
+  for (std::size_t i = 0; i < n; i++) {
+    word |= (uint64_t)(std::abs(a * x[i] + b * y[i] + c) <= bound) << i;
+  }
+  return word;
+}
+
+static int count_inliers_masked_scalar(const double *x, const double *y, std::size_t n, double a, double b, double c, double bound,
+                                       const uint64_t *active, uint64_t *out)
+{
+  int inliers = 0;
+  for (std::size_t w = 0; w * 64 < n; w++) {
+    if (active[w] == 0) {
+      if (out != nullptr) out[w] = 0;
+      continue;
+    }
+    uint64_t word = inlier_word_scalar(x + w * 64, y + w * 64, std::min<std::size_t>(64, n - w * 64), a, b, c, bound) & active[w];
+    inliers += __builtin_popcountll(word);
+    if (out != nullptr) out[w] = word;
+  }
+  return inliers;
+}
+
+__attribute__((target("avx2,popcnt")))
+static int count_inliers_masked_avx2(const double *x, const double *y, std::size_t n, double a, double b, double c, double bound,
+                                     const uint64_t *active, uint64_t *out)
+{
+  const __m256d va = _mm256_set1_pd(a);
+  const __m256d vb = _mm256_set1_pd(b);
+  const __m256d vc = _mm256_set1_pd(c);
+  const __m256d vbound = _mm256_set1_pd(bound);
+  const __m256d signMask = _mm256_set1_pd(-0.0);
+
+  int inliers = 0;
+  std::size_t w = 0;
+
+  for (; (w + 1) * 64 <= n; w++) {
+    uint64_t word = 0;
+    // Fully removed words cost nothing, which is what makes later rounds of
+    // multi-line extraction cheap
+    if (active[w] != 0) {
+      const double *px = x + w * 64;
+      const double *py = y + w * 64;
+      for (int k = 0; k < 16; k++) {
+        __m256d d = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(va, _mm256_loadu_pd(px + 4 * k)),
+                                                _mm256_mul_pd(vb, _mm256_loadu_pd(py + 4 * k))), vc);
+        __m256d inside = _mm256_cmp_pd(_mm256_andnot_pd(signMask, d), vbound, _CMP_LE_OQ);
+        word |= (uint64_t)_mm256_movemask_pd(inside) << (4 * k);
+      }
+      word &= active[w];
+      inliers += _mm_popcnt_u64(word);
+    }
+    if (out != nullptr) out[w] = word;
+  }
+
+  if (w * 64 < n) {
+    inliers += count_inliers_masked_scalar(x + w * 64, y + w * 64, n - w * 64, a, b, c, bound,
+                                           active + w, out != nullptr ? out + w : nullptr);
+  }
+  return inliers;
+}
+
+__attribute__((target("avx512f,popcnt")))
+static int count_inliers_masked_avx512(const double *x, const double *y, std::size_t n, double a, double b, double c, double bound,
+                                       const uint64_t *active, uint64_t *out)
+{
+  const __m512d va = _mm512_set1_pd(a);
+  const __m512d vb = _mm512_set1_pd(b);
+  const __m512d vc = _mm512_set1_pd(c);
+  const __m512d vbound = _mm512_set1_pd(bound);
+
+  int inliers = 0;
+  std::size_t w = 0;
+
+  for (; (w + 1) * 64 <= n; w++) {
+    uint64_t word = 0;
+    if (active[w] != 0) {
+      const double *px = x + w * 64;
+      const double *py = y + w * 64;
+      for (int k = 0; k < 8; k++) {
+        __m512d d = _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(va, _mm512_loadu_pd(px + 8 * k)),
+                                                _mm512_mul_pd(vb, _mm512_loadu_pd(py + 8 * k))), vc);
+        word |= (uint64_t)_mm512_cmp_pd_mask(_mm512_abs_pd(d), vbound, _CMP_LE_OQ) << (8 * k);
+      }
+      word &= active[w];
+      inliers += _mm_popcnt_u64(word);
+    }
+    if (out != nullptr) out[w] = word;
+  }
+
+  if (w * 64 < n) {
+    inliers += count_inliers_masked_scalar(x + w * 64, y + w * 64, n - w * 64, a, b, c, bound,
+                                           active + w, out != nullptr ? out + w : nullptr);
+  }
+  return inliers;
+}
+
+// Lane k of every sum holds the points i with i % 8 == k
+struct MomentLanes {
+  int count = 0;
+  double sx[8] = {}, sy[8] = {};
+  double sxx[8] = {}, sxy[8] = {}, syy[8] = {};
+
+  void add_scalar(const double *x, const double *y, std::size_t from, std::size_t n, double a, double b, double c, double bound,
+                  const uint64_t *active)
+  {
+    for (std::size_t i = from; i < n; i++) {
+      if (active != nullptr && !((active[i / 64] >> (i % 64)) & 1)) {
+        continue;
+      }
+      if (std::abs(a * x[i] + b * y[i] + c) <= bound) {
+        std::size_t k = i % 8;
+        count++;
+        sx[k] += x[i];
+        sy[k] += y[i];
+        sxx[k] += x[i] * x[i];
+        sxy[k] += x[i] * y[i];
+        syy[k] += y[i] * y[i];
+      }
+    }
+  }
+
+  LineMoments reduce() const
+  {
+    LineMoments m;
+    m.count = count;
+    for (int k = 0; k < 8; k++) {
+      m.sx += sx[k];
+      m.sy += sy[k];
+      m.sxx += sxx[k];
+      m.sxy += sxy[k];
+      m.syy += syy[k];
+    }
+    return m;
+  }
+};
+
+__attribute__((target("avx2,popcnt")))
+static LineMoments inlier_moments_avx2(const double *x, const double *y, std::size_t n, double a, double b, double c, double bound,
+                                       const uint64_t *active)
+{
+  const __m256d va = _mm256_set1_pd(a);
+  const __m256d vb = _mm256_set1_pd(b);
+  const __m256d vc = _mm256_set1_pd(c);
+  const __m256d vbound = _mm256_set1_pd(bound);
+  const __m256d signMask = _mm256_set1_pd(-0.0);
+  const __m256i laneBits = _mm256_set_epi64x(8, 4, 2, 1);
+
+  // [0] holds lanes 0-3, [1] lanes 4-7
+  __m256d sx[2] = { _mm256_setzero_pd(), _mm256_setzero_pd() };
+  __m256d sy[2] = { _mm256_setzero_pd(), _mm256_setzero_pd() };
+  __m256d sxx[2] = { _mm256_setzero_pd(), _mm256_setzero_pd() };
+  __m256d sxy[2] = { _mm256_setzero_pd(), _mm256_setzero_pd() };
+  __m256d syy[2] = { _mm256_setzero_pd(), _mm256_setzero_pd() };
+  MomentLanes lanes;
+  std::size_t i = 0;
+
+  for (; i + 8 <= n; i += 8) {
+    for (int h = 0; h < 2; h++) {
+      __m256d px = _mm256_loadu_pd(x + i + 4 * h);
+      __m256d py = _mm256_loadu_pd(y + i + 4 * h);
+      __m256d d = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(va, px), _mm256_mul_pd(vb, py)), vc);
+      __m256d mask = _mm256_cmp_pd(_mm256_andnot_pd(signMask, d), vbound, _CMP_LE_OQ);
+      if (active != nullptr) {
+        // Spread the 4 active bits of this group over the 4 lanes
+        __m256i bits = _mm256_set1_epi64x((long long)((active[(i + 4 * h) / 64] >> ((i + 4 * h) % 64)) & 0xF));
+        mask = _mm256_and_pd(mask, _mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(bits, laneBits), laneBits)));
+      }
+      lanes.count += _mm_popcnt_u32(_mm256_movemask_pd(mask));
+      sx[h] = _mm256_add_pd(sx[h], _mm256_and_pd(mask, px));
+      sy[h] = _mm256_add_pd(sy[h], _mm256_and_pd(mask, py));
+      sxx[h] = _mm256_add_pd(sxx[h], _mm256_and_pd(mask, _mm256_mul_pd(px, px)));
+      sxy[h] = _mm256_add_pd(sxy[h], _mm256_and_pd(mask, _mm256_mul_pd(px, py)));
+      syy[h] = _mm256_add_pd(syy[h], _mm256_and_pd(mask, _mm256_mul_pd(py, py)));
+    }
+  }
+
+  for (int h = 0; h < 2; h++) {
+    _mm256_storeu_pd(lanes.sx + 4 * h, sx[h]);
+    _mm256_storeu_pd(lanes.sy + 4 * h, sy[h]);
+    _mm256_storeu_pd(lanes.sxx + 4 * h, sxx[h]);
+    _mm256_storeu_pd(lanes.sxy + 4 * h, sxy[h]);
+    _mm256_storeu_pd(lanes.syy + 4 * h, syy[h]);
+  }
+  lanes.add_scalar(x, y, i, n, a, b, c, bound, active);
+  return lanes.reduce();
+}
+
+__attribute__((target("avx512f,popcnt")))
+static LineMoments inlier_moments_avx512(const double *x, const double *y, std::size_t n, double a, double b, double c, double bound,
+                                         const uint64_t *active)
+{
+  const __m512d va = _mm512_set1_pd(a);
+  const __m512d vb = _mm512_set1_pd(b);
+  const __m512d vc = _mm512_set1_pd(c);
+  const __m512d vbound = _mm512_set1_pd(bound);
+
+  __m512d sx = _mm512_setzero_pd(), sy = _mm512_setzero_pd();
+  __m512d sxx = _mm512_setzero_pd(), sxy = _mm512_setzero_pd(), syy = _mm512_setzero_pd();
+  MomentLanes lanes;
+  std::size_t i = 0;
+
+  for (; i + 8 <= n; i += 8) {
+    __m512d px = _mm512_loadu_pd(x + i);
+    __m512d py = _mm512_loadu_pd(y + i);
+    __m512d d = _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(va, px), _mm512_mul_pd(vb, py)), vc);
+    __mmask8 mask = _mm512_cmp_pd_mask(_mm512_abs_pd(d), vbound, _CMP_LE_OQ);
+    if (active != nullptr) {
+      mask &= (__mmask8)(active[i / 64] >> (i % 64));
+    }
+    lanes.count += _mm_popcnt_u32(mask);
+    sx = _mm512_mask_add_pd(sx, mask, sx, px);
+    sy = _mm512_mask_add_pd(sy, mask, sy, py);
+    sxx = _mm512_mask_add_pd(sxx, mask, sxx, _mm512_mul_pd(px, px));
+    sxy = _mm512_mask_add_pd(sxy, mask, sxy, _mm512_mul_pd(px, py));
+    syy = _mm512_mask_add_pd(syy, mask, syy, _mm512_mul_pd(py, py));
+  }
+
+  _mm512_storeu_pd(lanes.sx, sx);
+  _mm512_storeu_pd(lanes.sy, sy);
+  _mm512_storeu_pd(lanes.sxx, sxx);
+  _mm512_storeu_pd(lanes.sxy, sxy);
+  _mm512_storeu_pd(lanes.syy, syy);
+  lanes.add_scalar(x, y, i, n, a, b, c, bound, active);
+  return lanes.reduce();
+}
+
+SimdLevel simd_level()
+{
+  static const SimdLevel level = [] {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+      return SimdLevel::AVX512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+      return SimdLevel::AVX2;
+    }
+    return SimdLevel::SCALAR;
+  }();
+  return level;
+}
+
+const char *simd_level_name(SimdLevel level)
+{
+  switch (level) {
+    case SimdLevel::AVX512:
+      return "AVX-512";
+    case SimdLevel::AVX2:
+      return "AVX2";
+    default:
+      return "scalar";
+  }
+}
+
+int count_inliers(const double *x, const double *y, std::size_t n, double a, double b, double c, double bound)
+{
+  switch (simd_level()) {
+    case SimdLevel::AVX512:
+      return count_inliers_avx512(x, y, n, a, b, c, bound);
+    case SimdLevel::AVX2:
+      return count_inliers_avx2(x, y, n, a, b, c, bound);
+    default:
+      return count_inliers_scalar(x, y, n, a, b, c, bound);
+  }
+}
+
+int count_inliers_masked(const double *x, const double *y, std::size_t n, double a, double b, double c, double bound,
+                         const uint64_t *active, uint64_t *out)
+{
+  switch (simd_level()) {
+    case SimdLevel::AVX512:
+      return count_inliers_masked_avx512(x, y, n, a, b, c, bound, active, out);
+    case SimdLevel::AVX2:
+      return count_inliers_masked_avx2(x, y, n, a, b, c, bound, active, out);
+    default:
+      return count_inliers_masked_scalar(x, y, n, a, b, c, bound, active, out);
+  }
+}
+
+LineMoments inlier_moments(const double *x, const double *y, std::size_t n, double a, double b, double c, double bound,
+                           const uint64_t *active)
+{
+  switch (simd_level()) {
+    case SimdLevel::AVX512:
+      return inlier_moments_avx512(x, y, n, a, b, c, bound, active);
+    case SimdLevel::AVX2:
+      return inlier_moments_avx2(x, y, n, a, b, c, bound, active);
+    default: {
+      MomentLanes lanes;
+      lanes.add_scalar(x, y, 0, n, a, b, c, bound, active);
+      return lanes.reduce();
+    }
+  }
+}
@@ -0,0 +1,45 @@
+#ifndef __INLIER_KERNEL_H__
+#define __INLIER_KERNEL_H__
+
+#include <cstddef>
+#include <cstdint>
+
+// Instruction set picked at startup for the RANSAC kernels
+enum class SimdLevel {
+  SCALAR,
+  AVX2,
+  AVX512,
+};
+
+SimdLevel simd_level();
+const char *simd_level_name(SimdLevel level);
+
+// Number of points i in [0, n) with |a * x[i] + b * y[i] + c| <= bound.
+// With bound = t * sqrt(a^2 + b^2) this is the distance test of RANSAC step
+// 4.c/4.d without a per-point division. Every path evaluates
+// (a * x + b * y) + c in the same order without FMA, so the count is the same
+// whichever instruction set runs it.
+int count_inliers(const double *x, const double *y, std::size_t n, double a, double b, double c, double bound);
+
+// count_inliers restricted to the active points: bit i % 64 of active[i / 64]
+// marks point i. When out is given, the inlier bits of the active points are
+// stored there in the same layout. x, y and active must start on a 64-point
+// boundary of the set they belong to.
+int count_inliers_masked(const double *x, const double *y, std::size_t n, double a, double b, double c, double bound,
+                         const uint64_t *active, uint64_t *out = nullptr);
+
+// Sums over the inliers of a line, enough for a least-squares refit
+struct LineMoments {
+  int count = 0;
+  double sx = 0, sy = 0;
+  double sxx = 0, sxy = 0, syy = 0;
+};
+
+// Same inlier test as count_inliers, accumulating the moments of the inliers,
+// optionally among the active points only. Sums are kept in 8 interleaved
+// lanes on every path and reduced in a fixed order, so the result does not
+// depend on the instruction set either.
+LineMoments inlier_moments(const double *x, const double *y, std::size_t n, double a, double b, double c, double bound,
+                           const uint64_t *active = nullptr);
+
+#endif // __INLIER_KERNEL_H__
@@ -0,0 +1,129 @@
+#include "models.h"
+#include "inlier_kernel.h"
+
+using namespace cv;
+using namespace std;
+
+namespace {
+
+// Calls f(x) with the coordinates of every row within t of the model
+template <typename Model, typename F>
+void for_each_inlier(const PointTable<Model::kDims> &points, const typename Model::Params &params, double t, F f)
+{
+  typename Model::Kernel kernel(params);
+  const double *cols[Model::kDims];
+  for (int d = 0; d < Model::kDims; d++) {
+    cols[d] = points.col(d);
+  }
+
+  for (size_t i = 0; i < points.size(); i++) {
+    if (kernel(cols, i) <= t * t) {
+      double row[Model::kDims];
+      for (int d = 0; d < Model::kDims; d++) {
+        row[d] = cols[d][i];
+      }
+      f(row);
+    }
+  }
+}
+
+} // namespace
+
+bool Line2dModel::refine(const PointTable<2> &points, const Params &line, double t, Params &refined)
+{
+  // The normal is a unit vector, so the distance bound is t itself
+  LineMoments m = inlier_moments(points.col(0), points.col(1), points.size(), line.a, line.b, line.c, t);
+  return fit_line(m, refined);
+}
+
+// Algebraic (Kasa) fit x^2 + y^2 + D x + E y + F = 0, around the current
+// center to keep the normal equations well conditioned
+bool Circle2dModel::refine(const PointTable<2> &points, const Params &circle, double t, Params &refined)
+{
+  Matx33d A = Matx33d::zeros();
+  Vec3d b(0, 0, 0);
+
+  for_each_inlier<Circle2dModel>(points, circle, t, [&](const double *row) {
+    Vec3d v(row[0] - circle.cx, row[1] - circle.cy, 1.0);
+    double z = v[0] * v[0] + v[1] * v[1];
+    A += v * v.t();
+    b -= z * v;
+  });
+
+  Vec3d def;
+  if (A(2, 2) < 3 || !solve(A, b, def, DECOMP_CHOLESKY)) {
+    return false;
+  }
+
+  double ux = -def[0] / 2, uy = -def[1] / 2;
+  double r2 = ux * ux + uy * uy - def[2];
+  if (r2 <= 0.0) {
+    return false;
+  }
+
+  refined.cx = circle.cx + ux;
+  refined.cy = circle.cy + uy;
+  refined.r = sqrt(r2);
+  return true;
+}
+
+// Linear least squares, one 3 x 3 system per target coordinate
+bool Affine2dModel::refine(const PointTable<4> &points, const Params &affine, double t, Params &refined)
+{
+  Matx33d A = Matx33d::zeros();
+  Vec3d bu(0, 0, 0), bv(0, 0, 0);
+
+  for_each_inlier<Affine2dModel>(points, affine, t, [&](const double *row) {
+    Vec3d v(row[0], row[1], 1.0);
+    A += v * v.t();
+    bu += row[2] * v;
+    bv += row[3] * v;
+  });
+
+  Vec3d mu, mv;
+  if (A(2, 2) < 3 || !solve(A, bu, mu, DECOMP_CHOLESKY) || !solve(A, bv, mv, DECOMP_CHOLESKY)) {
+    return false;
+  }
+
+  for (int k = 0; k < 3; k++) {
+    refined.m[k] = mu[k];
+    refined.m[3 + k] = mv[k];
+  }
+  return true;
+}
+
+// Total least squares: the normal is the direction of least spread of the
+// inliers around their centroid
+bool Plane3dModel::refine(const PointTable<3> &points, const Params &plane, double t, Params &refined)
+{
+  Vec3d sum(0, 0, 0);
+  Matx33d products = Matx33d::zeros();
+  int count = 0;
+
+  for_each_inlier<Plane3dModel>(points, plane, t, [&](const double *row) {
+    Vec3d p(row[0], row[1], row[2]);
+    sum += p;
+    products += p * p.t();
+    count++;
+  });
+
+  if (count < 3) {
+    return false;
+  }
+
+  Vec3d mean = sum / count;
+  Matx33d covariance = products * (1.0 / count) - mean * mean.t();
+
+  Vec3d values;
+  Matx33d vectors;
+  if (!eigen(covariance, values, vectors)) {
+    return false;
+  }
+
+  // Eigenvalues come in descending order
+  refined.a = vectors(2, 0);
+  refined.b = vectors(2, 1);
+  refined.c = vectors(2, 2);
+  refined.d = -(refined.a * mean[0] + refined.b * mean[1] + refined.c * mean[2]);
+  return true;
+}
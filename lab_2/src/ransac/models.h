@@ -0,0 +1,193 @@
+#ifndef __RANSAC_MODELS_H__
+#define __RANSAC_MODELS_H__
+
+#include "engine.h"
+#include "ransac.h"
+#include <cmath>
+
+// Model policies for Ransac<Model, Sampler, Verifier>. fit and the residual
+// kernels are inline so that every instantiation is specialized for them;
+// refine runs once per improvement and lives in models.cpp.
+
+// 2D line a * x + b * y + c = 0 with a unit normal, over rows (x, y)
+struct Line2dModel {
+  static constexpr int kDims = 2;
+  static constexpr int kSampleSize = 2;
+  using Params = LineModel;
+
+  static bool fit(const PointTable<2> &points, const uint32_t *sample, Params &line)
+  {
+    double x1 = points.at(sample[0], 0), y1 = points.at(sample[0], 1);
+    double x2 = points.at(sample[1], 0), y2 = points.at(sample[1], 1);
+
+    double a = y1 - y2, b = x2 - x1;
+    double norm = std::sqrt(a * a + b * b);
+    if (norm == 0.0) {
+      return false;
+    }
+
+    line.a = a / norm;
+    line.b = b / norm;
+    line.c = -(line.a * x1 + line.b * y1);
+    return true;
+  }
+
+  struct Kernel {
+    double a, b, c;
+    explicit Kernel(const Params &line) :a(line.a), b(line.b), c(line.c) {}
+
+    double operator()(const double *const *cols, std::size_t i) const
+    {
+      double r = a * cols[0][i] + b * cols[1][i] + c;
+      return r * r;
+    }
+  };
+
+  static bool refine(const PointTable<2> &points, const Params &line, double t, Params &refined);
+};
+
+// 2D circle of center (cx, cy) and radius r, over rows (x, y)
+struct Circle2dModel {
+  static constexpr int kDims = 2;
+  static constexpr int kSampleSize = 3;
+  struct Params {
+    double cx = 0.0, cy = 0.0, r = 0.0;
+  };
+
+  // Circumcircle of the three sample points
+  static bool fit(const PointTable<2> &points, const uint32_t *sample, Params &circle)
+  {
+    double x1 = points.at(sample[0], 0), y1 = points.at(sample[0], 1);
+    double x2 = points.at(sample[1], 0) - x1, y2 = points.at(sample[1], 1) - y1;
+    double x3 = points.at(sample[2], 0) - x1, y3 = points.at(sample[2], 1) - y1;
+
+    double d = 2.0 * (x2 * y3 - x3 * y2);
+    if (std::abs(d) < 1e-9 * (x2 * x2 + y2 * y2 + x3 * x3 + y3 * y3)) {
+      return false;
+    }
+
+    double s2 = x2 * x2 + y2 * y2, s3 = x3 * x3 + y3 * y3;
+    double ux = (y3 * s2 - y2 * s3) / d;
+    double uy = (x2 * s3 - x3 * s2) / d;
+
+    circle.cx = x1 + ux;
+    circle.cy = y1 + uy;
+    circle.r = std::sqrt(ux * ux + uy * uy);
+    return true;
+  }
+
+  // Distance to the circle, not to its center
+  struct Kernel {
+    double cx, cy, r;
+    explicit Kernel(const Params &circle) :cx(circle.cx), cy(circle.cy), r(circle.r) {}
+
+    double operator()(const double *const *cols, std::size_t i) const
+    {
+      double dx = cols[0][i] - cx, dy = cols[1][i] - cy;
+      double e = std::sqrt(dx * dx + dy * dy) - r;
+      return e * e;
+    }
+  };
+
+  static bool refine(const PointTable<2> &points, const Params &circle, double t, Params &refined);
+};
+
+// 2D affine transform (u, v) = A (x, y) + b, over correspondences (x, y, u, v)
+struct Affine2dModel {
+  static constexpr int kDims = 4;
+  static constexpr int kSampleSize = 3;
+  struct Params {
+    double m[6] = { 1.0, 0.0, 0.0, 0.0, 1.0, 0.0 }; // u = m0 x + m1 y + m2, v = m3 x + m4 y + m5
+  };
+
+  static bool fit(const PointTable<4> &points, const uint32_t *sample, Params &affine)
+  {
+    // Relative to the first correspondence, A maps the two edge vectors of
+    // the source triangle onto those of the target one
+    double x0 = points.at(sample[0], 0), y0 = points.at(sample[0], 1);
+    double u0 = points.at(sample[0], 2), v0 = points.at(sample[0], 3);
+    double x1 = points.at(sample[1], 0) - x0, y1 = points.at(sample[1], 1) - y0;
+    double x2 = points.at(sample[2], 0) - x0, y2 = points.at(sample[2], 1) - y0;
+    double u1 = points.at(sample[1], 2) - u0, v1 = points.at(sample[1], 3) - v0;
+    double u2 = points.at(sample[2], 2) - u0, v2 = points.at(sample[2], 3) - v0;
+
+    // Collinear source points leave the transform undetermined
+    double det = x1 * y2 - x2 * y1;
+    if (std::abs(det) < 1e-9 * (x1 * x1 + y1 * y1 + x2 * x2 + y2 * y2)) {
+      return false;
+    }
+
+    affine.m[0] = (u1 * y2 - u2 * y1) / det;
+    affine.m[1] = (u2 * x1 - u1 * x2) / det;
+    affine.m[3] = (v1 * y2 - v2 * y1) / det;
+    affine.m[4] = (v2 * x1 - v1 * x2) / det;
+    affine.m[2] = u0 - affine.m[0] * x0 - affine.m[1] * y0;
+    affine.m[5] = v0 - affine.m[3] * x0 - affine.m[4] * y0;
+    return true;
+  }
+
+  // Squared transfer error in the target image
+  struct Kernel {
+    double m0, m1, m2, m3, m4, m5;
+    explicit Kernel(const Params &affine)
+      :m0(affine.m[0]), m1(affine.m[1]), m2(affine.m[2]), m3(affine.m[3]), m4(affine.m[4]), m5(affine.m[5])
+    {
+    }
+
+    double operator()(const double *const *cols, std::size_t i) const
+    {
+      double x = cols[0][i], y = cols[1][i];
+      double du = m0 * x + m1 * y + m2 - cols[2][i];
+      double dv = m3 * x + m4 * y + m5 - cols[3][i];
+      return du * du + dv * dv;
+    }
+  };
+
+  static bool refine(const PointTable<4> &points, const Params &affine, double t, Params &refined);
+};
+
+// 3D plane a * x + b * y + c * z + d = 0 with a unit normal, over rows (x, y, z)
+struct Plane3dModel {
+  static constexpr int kDims = 3;
+  static constexpr int kSampleSize = 3;
+  struct Params {
+    double a = 0.0, b = 0.0, c = 1.0, d = 0.0;
+  };
+
+  static bool fit(const PointTable<3> &points, const uint32_t *sample, Params &plane)
+  {
+    double x0 = points.at(sample[0], 0), y0 = points.at(sample[0], 1), z0 = points.at(sample[0], 2);
+    double x1 = points.at(sample[1], 0) - x0, y1 = points.at(sample[1], 1) - y0, z1 = points.at(sample[1], 2) - z0;
+    double x2 = points.at(sample[2], 0) - x0, y2 = points.at(sample[2], 1) - y0, z2 = points.at(sample[2], 2) - z0;
+
+    // Normal as the cross product of two edges of the sample triangle
+    double a = y1 * z2 - z1 * y2;
+    double b = z1 * x2 - x1 * z2;
+    double c = x1 * y2 - y1 * x2;
+    double norm = std::sqrt(a * a + b * b + c * c);
+    if (norm == 0.0) {
+      return false;
+    }
+
+    plane.a = a / norm;
+    plane.b = b / norm;
+    plane.c = c / norm;
+    plane.d = -(plane.a * x0 + plane.b * y0 + plane.c * z0);
+    return true;
+  }
+
+  struct Kernel {
+    double a, b, c, d;
+    explicit Kernel(const Params &plane) :a(plane.a), b(plane.b), c(plane.c), d(plane.d) {}
+
+    double operator()(const double *const *cols, std::size_t i) const
+    {
+      double r = a * cols[0][i] + b * cols[1][i] + c * cols[2][i] + d;
+      return r * r;
+    }
+  };
+
+  static bool refine(const PointTable<3> &points, const Params &plane, double t, Params &refined);
+};
+
+#endif // __RANSAC_MODELS_H__
@@ -0,0 +1,74 @@
+#include "multi_line.h"
+#include "inlier_kernel.h"
+
+#include <cmath>
+
+using namespace cv;
+using namespace std;
+
+vector<LineDetection> ransac_multi_line(const vector<Point2d> &points, double t, int T, int N,
+                                        const RansacOptions &options, int max_lines)
+{
+  return ransac_multi_line(PointSet(points), t, T, N, options, max_lines);
+}
+
+vector<LineDetection> ransac_multi_line(const PointSet &points, double t, int T, int N,
+                                        const RansacOptions &options, int max_lines)
+{
+  vector<LineDetection> lines;
+
+  // SPRT needs the points in random order. Shuffle them once here instead of
+  // once per round, and map the consensus sets back at the end. PROSAC needs
+  // them in quality order, so there each round shuffles a copy instead.
+  vector<uint32_t> perm;
+  PointSet shuffled;
+  RansacOptions round_options = options;
+
+  if (options.verification == Verification::SPRT && !options.shuffled_input && options.sampling != Sampling::PROSAC) {
+    shuffled = shuffle_points(points, options.seed, &perm);
+    round_options.shuffled_input = true;
+  }
+
+  const PointSet &input = perm.empty() ? points : shuffled;
+  ConsensusMask active(input.size(), true);
+
+  for (int round = 0; round < max_lines && active.popcount() >= 2; round++) {
+    round_options.seed = options.seed + round;
+
+    RansacResult result = ransac_parallel(input, t, T, N, round_options, &active);
+    if (!result.found || result.inliers < T) {
+      break;
+    }
+
+    // Consensus set of the line among the points still active
+    const LineModel &line = result.line;
+    double bound = t * sqrt(line.a * line.a + line.b * line.b);
+
+    LineDetection detection;
+    detection.line = line;
+    detection.consensus.assign(input.size(), false);
+    detection.inliers = count_inliers_masked(input.x(), input.y(), input.size(), line.a, line.b, line.c, bound,
+                                             active.data(), detection.consensus.data());
+
+    if (detection.inliers == 0) {
+      break;
+    }
+
+    active.subtract(detection.consensus);
+    lines.push_back(std::move(detection));
+  }
+
+  if (!perm.empty()) {
+    for (LineDetection &detection : lines) {
+      ConsensusMask original(points.size(), false);
+      for (size_t i = 0; i < perm.size(); i++) {
+        if (detection.consensus.test(i)) {
+          original.set(perm[i]);
+        }
+      }
+      detection.consensus = std::move(original);
+    }
+  }
+
+  return lines;
+}
@@ -0,0 +1,26 @@
+#ifndef __MULTI_LINE_H__
+#define __MULTI_LINE_H__
+
+#include "ransac.h"
+#include "consensus_mask.h"
+#include <vector>
+
+// A line found by sequential RANSAC and the points it took
+struct LineDetection {
+  LineModel line;
+  int inliers = 0;
+  ConsensusMask consensus; // over the input points
+};
+
+// Sequential RANSAC: find the best line, remove its consensus set and search
+// again among the remaining points, until a round finds fewer than T inliers
+// or max_lines lines are found. Points are never copied between rounds; each
+// round only clears the consensus bits from the active mask, so the removed
+// points cost one skipped word per 64 in later counts. Round r uses seed
+// options.seed + r.
+std::vector<LineDetection> ransac_multi_line(const PointSet &points, double t, int T, int N,
+                                             const RansacOptions &options = {}, int max_lines = 16);
+std::vector<LineDetection> ransac_multi_line(const std::vector<cv::Point2d> &points, double t, int T, int N,
+                                             const RansacOptions &options = {}, int max_lines = 16);
+
+#endif // __MULTI_LINE_H__
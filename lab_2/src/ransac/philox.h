@@ -0,0 +1,85 @@
+#ifndef __PHILOX_H__
+#define __PHILOX_H__
+
+#include <array>
+#include <cstdint>
+#include <limits>
+
+// Philox4x32-10 counter-based generator (Salmon et al., "Parallel random
+// numbers: as easy as 1, 2, 3"). Every (seed, stream) pair is an independent
+// sequence that needs no shared state, so a worker can jump straight to the
+// numbers of any hypothesis and get the same values on any thread.
+class Philox4x32 {
+  std::array<uint32_t, 2> key;
+  std::array<uint32_t, 4> counter;
+  std::array<uint32_t, 4> block{};
+  int used = 4;
+
+  static void mulhilo(uint32_t a, uint32_t b, uint32_t &hi, uint32_t &lo)
+  {
+    uint64_t product = (uint64_t)a * b;
+    hi = (uint32_t)(product >> 32);
+    lo = (uint32_t)product;
+  }
+
+public:
+  using result_type = uint32_t;
+
+  Philox4x32(uint64_t seed, uint64_t stream)
+    :key{ (uint32_t)seed, (uint32_t)(seed >> 32) },
+     counter{ 0, 0, (uint32_t)stream, (uint32_t)(stream >> 32) }
+  {
+  }
+
+  static std::array<uint32_t, 4> generate(std::array<uint32_t, 4> ctr, std::array<uint32_t, 2> k)
+  {
+    for (int round = 0; round < 10; round++) {
+      uint32_t hi0, lo0, hi1, lo1;
+      mulhilo(0xD2511F53u, ctr[0], hi0, lo0);
+      mulhilo(0xCD9E8D57u, ctr[2], hi1, lo1);
+      ctr = { hi1 ^ ctr[1] ^ k[0], lo1, hi0 ^ ctr[3] ^ k[1], lo0 };
+      k[0] += 0x9E3779B9u;
+      k[1] += 0xBB67AE85u;
+    }
+    return ctr;
+  }
+
+  uint32_t operator()()
+  {
+    if (used == 4) {
+      block = generate(counter, key);
+      // The low 64 bits of the counter index blocks within the stream
+      if (++counter[0] == 0) {
+        counter[1]++;
+      }
+      used = 0;
+    }
+    return block[used++];
+  }
+
+  // Unbiased integer in [0, n), Lemire's multiply-and-reject method
+  uint32_t uniform(uint32_t n)
+  {
+    uint64_t m = (uint64_t)(*this)() * n;
+    uint32_t low = (uint32_t)m;
+    if (low < n) {
+      uint32_t threshold = (0u - n) % n;
+      while (low < threshold) {
+        m = (uint64_t)(*this)() * n;
+        low = (uint32_t)m;
+      }
+    }
+    return (uint32_t)(m >> 32);
+  }
+
+  // Double in [0, 1) with 32 random bits
+  double uniform01()
+  {
+    return (*this)() * (1.0 / 4294967296.0);
+  }
+
+  static constexpr uint32_t min() { return 0; }
+  static constexpr uint32_t max() { return std::numeric_limits<uint32_t>::max(); }
+};
+
+#endif // __PHILOX_H__
@@ -0,0 +1,67 @@
+#include "point_set.h"
+#include "philox.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+PointSet::PointSet(const std::vector<cv::Point2d> &points)
+{
+  assign(points);
+}
+
+void PointSet::assign(const std::vector<cv::Point2d> &points)
+{
+  resize(points.size());
+  for (std::size_t i = 0; i < points.size(); i++) {
+    xs[i] = points[i].x;
+    ys[i] = points[i].y;
+  }
+}
+
+void PointSet::resize(std::size_t n)
+{
+  const std::size_t padded = (n + kLanes - 1) / kLanes * kLanes;
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+
+  count = n;
+  xs.resize(padded);
+  ys.resize(padded);
+  std::fill(xs.begin() + n, xs.end(), nan);
+  std::fill(ys.begin() + n, ys.end(), nan);
+}
+
+PointSet shuffle_points(const PointSet &points, uint64_t seed, std::vector<uint32_t> *order,
+                        const ConsensusMask *mask)
+{
+  std::vector<uint32_t> perm;
+  if (mask == nullptr) {
+    perm.resize(points.size());
+    std::iota(perm.begin(), perm.end(), 0u);
+  }
+  else {
+    perm.reserve(mask->popcount());
+    for (uint32_t i = 0; i < points.size(); i++) {
+      if (mask->test(i)) {
+        perm.push_back(i);
+      }
+    }
+  }
+
+  Philox4x32 rng(seed, ~0ull);
+  for (std::size_t i = perm.size(); i > 1; i--) {
+    std::swap(perm[i - 1], perm[rng.uniform((uint32_t)i)]);
+  }
+
+  PointSet shuffled;
+  shuffled.resize(perm.size());
+  for (std::size_t i = 0; i < perm.size(); i++) {
+    shuffled.x()[i] = points.x()[perm[i]];
+    shuffled.y()[i] = points.y()[perm[i]];
+  }
+
+  if (order != nullptr) {
+    *order = std::move(perm);
+  }
+  return shuffled;
+}
@@ -0,0 +1,80 @@
+#ifndef __POINT_SET_H__
+#define __POINT_SET_H__
+
+#include "opencv2/opencv.hpp"
+#include "consensus_mask.h"
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+// Minimal allocator handing out storage aligned for full-width vector loads
+template <typename T, std::size_t Alignment>
+struct AlignedAllocator {
+  using value_type = T;
+
+  template <typename U>
+  struct rebind {
+    using other = AlignedAllocator<U, Alignment>;
+  };
+
+  AlignedAllocator() = default;
+  template <typename U>
+  AlignedAllocator(const AlignedAllocator<U, Alignment> &) {}
+
+  T *allocate(std::size_t n)
+  {
+    return static_cast<T *>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+  }
+
+  void deallocate(T *p, std::size_t)
+  {
+    ::operator delete(p, std::align_val_t(Alignment));
+  }
+
+  template <typename U>
+  bool operator==(const AlignedAllocator<U, Alignment> &) const { return true; }
+};
+
+// Point set in structure-of-arrays layout: separate x[] and y[] arrays,
+// 64-byte aligned and padded to a multiple of kLanes with NaN. NaN never
+// compares as an inlier, so kernels can run over padded_size() without a tail.
+class PointSet {
+public:
+  static constexpr std::size_t kAlignment = 64;
+  static constexpr std::size_t kLanes = kAlignment / sizeof(double);
+
+  using Buffer = std::vector<double, AlignedAllocator<double, kAlignment>>;
+
+private:
+  Buffer xs;
+  Buffer ys;
+  std::size_t count = 0;
+
+public:
+  PointSet() = default;
+  explicit PointSet(const std::vector<cv::Point2d> &points);
+
+  void assign(const std::vector<cv::Point2d> &points);
+  // Makes room for n points; the caller fills x() and y()
+  void resize(std::size_t n);
+
+  std::size_t size() const { return count; }
+  std::size_t padded_size() const { return xs.size(); }
+  bool empty() const { return count == 0; }
+
+  double *x() { return xs.data(); }
+  double *y() { return ys.data(); }
+  const double *x() const { return xs.data(); }
+  const double *y() const { return ys.data(); }
+
+  cv::Point2d operator[](std::size_t i) const { return cv::Point2d(xs[i], ys[i]); }
+};
+
+// The points in the fixed pseudo-random order of Philox stream (seed, ~0),
+// only those set in mask when there is one. order receives the index in the
+// input of every shuffled point.
+PointSet shuffle_points(const PointSet &points, uint64_t seed, std::vector<uint32_t> *order = nullptr,
+                        const ConsensusMask *mask = nullptr);
+
+#endif // __POINT_SET_H__
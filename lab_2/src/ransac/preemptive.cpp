@@ -0,0 +1,161 @@
+#include "preemptive.h"
+#include "philox.h"
+#include "sampler.h"
+#include "inlier_kernel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unistd.h>
+
+using namespace cv;
+using namespace std;
+
+namespace {
+
+// Point tests below which a block is scored on the calling thread
+constexpr size_t kParallelWork = 1 << 16;
+
+struct Hypothesis {
+  LineModel line;
+  double bound;
+  int score;
+  int index;
+};
+
+// More inliers first, then the lower index
+bool ranks_before(const Hypothesis &a, const Hypothesis &b)
+{
+  return a.score != b.score ? a.score > b.score : a.index < b.index;
+}
+
+} // namespace
+
+size_t preemptive_block_size()
+{
+  static const size_t size = [] {
+    long l1 = 0;
+#ifdef _SC_LEVEL1_DCACHE_SIZE
+    l1 = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+#endif
+    if (l1 <= 0) {
+      l1 = 32 * 1024;
+    }
+    size_t points = (size_t)l1 / 2 / (2 * sizeof(double));
+    return max<size_t>(64, points / 64 * 64);
+  }();
+  return size;
+}
+
+RansacResult ransac_preemptive(const vector<Point2d> &points, double t, int M, const RansacOptions &options,
+                               size_t block)
+{
+  return ransac_preemptive(PointSet(points), t, M, options, block);
+}
+
+RansacResult ransac_preemptive(const PointSet &points, double t, int M, const RansacOptions &options, size_t block)
+{
+  RansacResult result;
+
+  if (points.size() < 2 || M <= 0) {
+    return result;
+  }
+
+  if (block == 0) {
+    block = preemptive_block_size();
+  }
+
+  int workers = options.threads > 0 ? options.threads : getNumThreads();
+  workers = max(1, workers);
+
+  // Partial scores over a random prefix are what preemption compares
+  PointSet shuffled;
+  if (!options.shuffled_input) {
+    shuffled = shuffle_points(points, options.seed);
+  }
+  const PointSet &order = options.shuffled_input ? points : shuffled;
+
+  // 4.a and 4.b for all M hypotheses up front
+  ActivePoints active(points, nullptr);
+  Sampler sampler(active, options, t, M);
+  vector<Hypothesis> alive;
+  alive.reserve(M);
+
+  for (int h = 0; h < M; h++) {
+    Philox4x32 rng(options.seed, (uint64_t)h);
+    LineModel line;
+    if (sample_line(points, sampler, h, rng, line)) {
+      alive.push_back({ line, t * sqrt(line.a * line.a + line.b * line.b), 0, h });
+    }
+  }
+
+  result.iterations = M;
+  result.evaluated = M;
+
+  if (alive.empty()) {
+    return result;
+  }
+
+  // Breadth-first scoring: every live hypothesis sees block k before any sees
+  // block k + 1, and the block is read from cache for all but the first one
+  const size_t n = order.size();
+  size_t from = 0;
+
+  for (int k = 1; from < n && alive.size() > 1; k++) {
+    const size_t len = min(block, n - from);
+    const double *x = order.x() + from;
+    const double *y = order.y() + from;
+    const size_t live = alive.size();
+
+    int chunks = live * len >= kParallelWork ? (int)min<size_t>(workers, live) : 1;
+    auto score = [&](const Range &range) {
+      for (int c = range.start; c < range.end; c++) {
+        for (size_t i = live * c / chunks; i < live * (c + 1) / chunks; i++) {
+          Hypothesis &hypothesis = alive[i];
+          const LineModel &line = hypothesis.line;
+          hypothesis.score += count_inliers(x, y, len, line.a, line.b, line.c, hypothesis.bound);
+        }
+      }
+    };
+
+    if (chunks > 1) {
+      parallel_for_(Range(0, chunks), score, chunks);
+    }
+    else {
+      score(Range(0, 1));
+    }
+
+    result.point_tests += (long long)live * len;
+    from += len;
+
+    // Preemption function f(i) = floor(M * 2^(-floor(i / B)))
+    size_t keep = max<size_t>(1, (size_t)M >> min(k, 31));
+    if (keep < live) {
+      nth_element(alive.begin(), alive.begin() + keep, alive.end(), ranks_before);
+      alive.resize(keep);
+    }
+  }
+
+  const Hypothesis &winner = *min_element(alive.begin(), alive.end(), ranks_before);
+
+  result.line = winner.line;
+  result.hypothesis = winner.index;
+  result.found = true;
+
+  // Final least-squares polish on the consensus set, as in ransac_parallel
+  if (options.lo_iterations > 0) {
+    LineMoments m = inlier_moments(points.x(), points.y(), points.size(), winner.line.a, winner.line.b, winner.line.c,
+                                   winner.bound);
+    result.point_tests += points.size();
+    LineModel polished;
+    if (fit_line(m, polished)) {
+      result.line = polished;
+    }
+  }
+
+  const LineModel &line = result.line;
+  result.inliers = count_inliers(points.x(), points.y(), points.size(), line.a, line.b, line.c,
+                                 t * sqrt(line.a * line.a + line.b * line.b));
+  result.point_tests += points.size();
+
+  return result;
+}
@@ -0,0 +1,26 @@
+#ifndef __PREEMPTIVE_H__
+#define __PREEMPTIVE_H__
+
+#include "ransac.h"
+#include <cstddef>
+
+// Points per scoring block: the x and y arrays of a block fill half of the
+// L1 data cache, so a block stays hot while every live hypothesis is scored
+// against it
+std::size_t preemptive_block_size();
+
+// Preemptive RANSAC (Nister, "Preemptive RANSAC for live structure and motion
+// estimation"). M hypotheses are drawn up front from streams (seed, 0..M-1)
+// with the configured sampler, then scored breadth-first over the points in
+// random order, one block at a time. After the k-th block only the best
+// M / 2^k hypotheses by partial score survive, lowest index first on ties,
+// until one is left. A run costs at most 2 * M * block point tests plus one
+// full count of the winner, whatever the inlier ratio, and gives the same
+// result for any thread count. options.verification and options.adaptive do
+// not apply; lo_iterations > 0 polishes the winner by least squares.
+RansacResult ransac_preemptive(const PointSet &points, double t, int M, const RansacOptions &options = {},
+                               std::size_t block = 0);
+RansacResult ransac_preemptive(const std::vector<cv::Point2d> &points, double t, int M,
+                               const RansacOptions &options = {}, std::size_t block = 0);
+
+#endif // __PREEMPTIVE_H__
@@ -0,0 +1,465 @@
+#include "ransac.h"
+#include "philox.h"
+#include "inlier_kernel.h"
+#include "sampler.h"
+#include "../common/logger/logger.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <numeric>
+
+using namespace cv;
+using namespace std;
+
+namespace {
+
+// Points scored between two checks of the exact bail-out bound
+constexpr size_t kBailBlock = 1024;
+// Points scored between two SPRT decisions, one mask word
+constexpr size_t kSprtBlock = 64;
+
+// A hypothesis that beat every earlier one of the same worker
+struct Improvement {
+  int hypothesis;
+  int inliers;
+  LineModel line;
+};
+
+struct WorkerState {
+  std::vector<Improvement> improvements;
+  int raw_best = -1; // best count before local optimization
+  int evaluated = 0;
+  long long point_tests = 0;
+};
+
+// Best score published by any worker, packed as (inliers << 32 | ~hypothesis)
+// so that an atomic max prefers more inliers, then the lower index
+uint64_t pack_best(int inliers, int hypothesis)
+{
+  return ((uint64_t)inliers << 32) | (uint32_t)~(uint32_t)hypothesis;
+}
+
+// Score a hypothesis must beat to still matter. A hypothesis with fewer
+// inliers than an earlier one can neither win nor end the run earlier than
+// that one would, so it can be dropped without changing the result. Earlier
+// means earlier in the same worker, or, when the score is the plain inlier
+// count, a lower index anywhere.
+struct Bar {
+  const std::atomic<uint64_t> *global;
+  int local;
+  int hypothesis;
+
+  int value() const
+  {
+    int bar = local;
+    if (global != nullptr) {
+      uint64_t key = global->load(std::memory_order_relaxed);
+      if ((int)~(uint32_t)key < hypothesis) {
+        bar = std::max(bar, (int)(key >> 32));
+      }
+    }
+    return bar;
+  }
+};
+
+// Wald's SPRT state of one worker (Chum and Matas, "Optimal Randomized
+// RANSAC"). epsilon is the inlier ratio of a good model, delta the chance that
+// a point agrees with a bad one. Both are re-estimated from the worker's own
+// hypotheses only, which keeps the decisions independent of thread timing.
+struct Sprt {
+  double epsilon;
+  double delta;
+  double model_cost;
+  double log_a = 0.0; // reject once the log likelihood ratio exceeds this
+  double log_inlier_step = 0.0;
+  double log_outlier_step = 0.0;
+  double delta_sum = 0.0;
+  int rejected = 0;
+
+  Sprt(double epsilon, double delta, double model_cost)
+    :epsilon(epsilon), delta(delta), model_cost(model_cost)
+  {
+    update();
+  }
+
+  void update()
+  {
+    // delta stays within [1e-4, 0.99 epsilon], so epsilon may not go lower
+    // than 1e-4 / 0.99
+    epsilon = clamp(epsilon, 1e-4 / 0.99, 1.0 - 1e-4);
+    delta = clamp(delta, 1e-4, epsilon * 0.99);
+
+    log_inlier_step = log(delta / epsilon);
+    log_outlier_step = log((1.0 - delta) / (1.0 - epsilon));
+
+    // Optimal threshold from A = K1 / K2 + 1 + log(A), one model per sample
+    // (K2 = 1) and K1 = t_M * C
+    double c = (1.0 - delta) * log((1.0 - delta) / (1.0 - epsilon)) + delta * log(delta / epsilon);
+    double k = model_cost * c + 1.0;
+    double a = k;
+    for (int i = 0; i < 10; i++) {
+      a = k + log(a);
+    }
+    log_a = log(a);
+  }
+
+  void on_rejected(int agreeing, size_t tested)
+  {
+    delta_sum += (double)agreeing / tested;
+    rejected++;
+
+    double estimate = delta_sum / rejected;
+    if (abs(estimate - delta) > 0.05 * delta) {
+      delta = estimate;
+      update();
+    }
+  }
+
+  void on_new_best(int inliers, size_t n)
+  {
+    double estimate = (double)inliers / n;
+    if (estimate > epsilon) {
+      epsilon = estimate;
+      update();
+    }
+  }
+};
+
+class Verifier {
+  const ActivePoints &active;
+  const PointSet &order; // the same points in random order, for SPRT
+  const RansacOptions &options;
+  const double t;
+
+  // Active points in words [0, w) of the mask
+  vector<size_t> active_before;
+
+public:
+  Verifier(const ActivePoints &active, const PointSet &order, const RansacOptions &options, double t)
+    :active(active), order(order), options(options), t(t)
+  {
+    if (active.mask != nullptr) {
+      const uint64_t *words = active.words();
+      active_before.resize(active.mask->word_count() + 1, 0);
+      for (size_t w = 0; w < active.mask->word_count(); w++) {
+        active_before[w + 1] = active_before[w] + __builtin_popcountll(words[w]);
+      }
+    }
+  }
+
+  // Active points among the first i of the set
+  size_t active_until(size_t i) const
+  {
+    return active.mask != nullptr ? active_before[(i + 63) / 64] : i;
+  }
+
+  // Full count in blocks, with the exact bail-out between blocks. Blocks are
+  // whole mask words, so removed points are skipped a word at a time.
+  int count_with_bail(const LineModel &line, double bound, const Bar &bar, long long &tests) const
+  {
+    const PointSet &points = active.points;
+    const uint64_t *words = active.words();
+    const size_t n = points.size();
+    const size_t total = active.size();
+    int inliers = 0;
+
+    for (size_t i = 0; i < n; i += kBailBlock) {
+      size_t len = min(kBailBlock, n - i);
+      size_t tested = active_until(i + len) - active_until(i);
+      if (tested == 0) {
+        continue;
+      }
+
+      inliers += words != nullptr
+        ? count_inliers_masked(points.x() + i, points.y() + i, len, line.a, line.b, line.c, bound, words + i / 64)
+        : count_inliers(points.x() + i, points.y() + i, len, line.a, line.b, line.c, bound);
+      tests += tested;
+
+      if (inliers + (long long)(total - active_until(i + len)) < bar.value()) {
+        return -1;
+      }
+    }
+
+    return inliers;
+  }
+
+  // T(d,d): d random points must all be inliers before the full count
+  bool passes_tdd(const LineModel &line, double bound, Philox4x32 &rng, long long &tests) const
+  {
+    for (int k = 0; k < options.tdd_d; k++) {
+      Point2d p = active[rng.uniform((uint32_t)active.size())];
+      tests++;
+      if (abs(line.a * p.x + line.b * p.y + line.c) > bound) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // SPRT over the shuffled points. A model surviving every block has been
+  // scored against all points, so its count is exact. The exact bail-out is
+  // left out here: it depends on other workers and would make the delta
+  // estimate, and so later decisions, depend on thread timing.
+  int count_sprt(const LineModel &line, double bound, Sprt &sprt, long long &tests) const
+  {
+    // Without a copy the shuffled points carry the mask with them
+    const uint64_t *words = &order == &active.points ? active.words() : nullptr;
+    const size_t n = order.size();
+    int inliers = 0;
+    size_t tested = 0;
+    double log_lambda = 0.0;
+
+    for (size_t i = 0; i < n; i += kSprtBlock) {
+      size_t len = min(kSprtBlock, n - i);
+      size_t block = len;
+      int agreeing;
+
+      if (words != nullptr) {
+        block = __builtin_popcountll(words[i / 64]);
+        if (block == 0) {
+          continue;
+        }
+        agreeing = count_inliers_masked(order.x() + i, order.y() + i, len, line.a, line.b, line.c, bound, words + i / 64);
+      }
+      else {
+        agreeing = count_inliers(order.x() + i, order.y() + i, len, line.a, line.b, line.c, bound);
+      }
+
+      inliers += agreeing;
+      tested += block;
+      tests += block;
+
+      log_lambda += agreeing * sprt.log_inlier_step + (block - agreeing) * sprt.log_outlier_step;
+      if (log_lambda > sprt.log_a) {
+        sprt.on_rejected(inliers, tested);
+        return -1;
+      }
+    }
+
+    return inliers;
+  }
+
+  int verify(const LineModel &line, Philox4x32 &rng, Sprt &sprt, const Bar &bar, long long &tests) const
+  {
+    double bound = t * sqrt(line.a * line.a + line.b * line.b);
+
+    switch (options.verification) {
+      case Verification::TDD:
+        if (!passes_tdd(line, bound, rng, tests)) {
+          return -1;
+        }
+        return count_with_bail(line, bound, bar, tests);
+      case Verification::SPRT:
+        return count_sprt(line, bound, sprt, tests);
+      default:
+        return count_with_bail(line, bound, bar, tests);
+    }
+  }
+};
+
+// LO-RANSAC: refit the line to its consensus set until the set stops growing
+int optimize_locally(const ActivePoints &active, double t, int iterations, LineModel &line, int inliers, long long &tests)
+{
+  const PointSet &points = active.points;
+  double bound = t * sqrt(line.a * line.a + line.b * line.b);
+  LineMoments m = inlier_moments(points.x(), points.y(), points.size(), line.a, line.b, line.c, bound, active.words());
+  tests += active.size();
+
+  for (int i = 0; i < iterations; i++) {
+    LineModel refit;
+    if (!fit_line(m, refit)) {
+      break;
+    }
+
+    // The refit has a unit normal, so the distance bound is t itself
+    LineMoments next = inlier_moments(points.x(), points.y(), points.size(), refit.a, refit.b, refit.c, t, active.words());
+    tests += active.size();
+    if (next.count < inliers) {
+      break;
+    }
+
+    // A refit that keeps the same consensus set is still the better line
+    bool grew = next.count > inliers;
+    line = refit;
+    inliers = next.count;
+    m = next;
+
+    if (!grew) {
+      break;
+    }
+  }
+
+  return inliers;
+}
+
+} // namespace
+
+bool fit_line(const LineMoments &m, LineModel &line)
+{
+  if (m.count < 2) {
+    return false;
+  }
+
+  double mx = m.sx / m.count;
+  double my = m.sy / m.count;
+  double cxx = m.sxx / m.count - mx * mx;
+  double cxy = m.sxy / m.count - mx * my;
+  double cyy = m.syy / m.count - my * my;
+
+  // Direction of largest spread; the normal is perpendicular to it
+  double theta = 0.5 * atan2(2.0 * cxy, cxx - cyy);
+  line.a = -sin(theta);
+  line.b = cos(theta);
+  line.c = -(line.a * mx + line.b * my);
+
+  return true;
+}
+
+RansacResult ransac_parallel(const vector<Point2d> &points, double t, int T, int N, const RansacOptions &options)
+{
+  return ransac_parallel(PointSet(points), t, T, N, options);
+}
+
+RansacResult ransac_parallel(const PointSet &points, double t, int T, int N, const RansacOptions &options,
+                             const ConsensusMask *active_mask)
+{
+  RansacResult result;
+  ActivePoints active(points, active_mask);
+  const size_t n = active.size();
+
+  if (n < 2 || N <= 0) {
+    return result;
+  }
+
+  int workers = options.threads > 0 ? options.threads : getNumThreads();
+  workers = max(1, min(workers, N));
+
+  // The active points in a fixed pseudo-random order, so that every SPRT
+  // prefix is a random subset
+  PointSet order;
+  bool copy_order = options.verification == Verification::SPRT && !options.shuffled_input;
+  if (copy_order) {
+    order = shuffle_points(points, options.seed, nullptr, active_mask);
+  }
+  Verifier verifier(active, copy_order ? order : points, options, t);
+  Sampler sampler(active, options, t, N);
+
+  // A sequential loop stops after hypothesis h once h + 1 reaches the number
+  // of hypotheses it needs, which is N, or fewer with adaptive termination,
+  // or h itself when h reaches T. Its last hypothesis is then the minimum of
+  // that bound over all hypotheses, which workers can lower in any order and
+  // stop once they pass it.
+  atomic<int> last_needed(N - 1);
+  atomic<uint64_t> best_score(pack_best(0, N));
+  // With LO the score of a hypothesis depends on its worker's history, so
+  // only the worker's own best is a safe bail-out bar. So it is with adaptive
+  // PROSAC or NAPSAC termination: the hypotheses needed depend on which
+  // points are inliers, so a later hypothesis with fewer inliers may still
+  // lower the bound, but only if no other worker's best made it bail out.
+  const bool consensus_bound = options.adaptive && options.sampling != Sampling::UNIFORM;
+  const atomic<uint64_t> *global_bar = options.lo_iterations > 0 || consensus_bound ? nullptr : &best_score;
+  vector<WorkerState> states(workers);
+
+  parallel_for_(Range(0, workers), [&](const Range &range) {
+    for (int w = range.start; w < range.end; w++) {
+      WorkerState &state = states[w];
+      Sprt sprt(options.sprt_epsilon, options.sprt_delta, options.sprt_model_cost);
+
+      for (int h = w; h <= last_needed.load(memory_order_relaxed); h += workers) {
+        Philox4x32 rng(options.seed, (uint64_t)h);
+        LineModel line;
+        state.evaluated++;
+
+        if (!sample_line(points, sampler, h, rng, line)) {
+          continue;
+        }
+
+        Bar bar{ global_bar, state.raw_best, h };
+        int inliers = verifier.verify(line, rng, sprt, bar, state.point_tests);
+        if (inliers <= state.raw_best) {
+          continue;
+        }
+        state.raw_best = inliers;
+
+        if (options.lo_iterations > 0) {
+          inliers = optimize_locally(active, t, options.lo_iterations, line, inliers, state.point_tests);
+        }
+
+        if (!state.improvements.empty() && inliers <= state.improvements.back().inliers) {
+          continue;
+        }
+
+        state.improvements.push_back({ h, inliers, line });
+        sprt.on_new_best(inliers, n);
+
+        uint64_t key = pack_best(inliers, h);
+        uint64_t shared = best_score.load(memory_order_relaxed);
+        while (key > shared && !best_score.compare_exchange_weak(shared, key, memory_order_relaxed)) {
+        }
+
+        // 5. Termination on the size of the consensus set and the number of
+        // hypotheses this inlier ratio needs
+        int last = inliers >= T ? h : options.adaptive
+          ? max(h, sampler.hypotheses_needed(line, t, inliers, options.confidence, N) - 1)
+          : N - 1;
+        int current = last_needed.load(memory_order_relaxed);
+        while (last < current && !last_needed.compare_exchange_weak(current, last, memory_order_relaxed)) {
+        }
+
+        if (inliers >= T) {
+          break;
+        }
+      }
+    }
+  }, workers);
+
+  // The best hypothesis up to the last one a sequential loop would have run,
+  // lowest index first. A worker may have gone further before it learned
+  // about the bound, so only its improvements up to the bound count.
+  const int last = last_needed.load();
+  const Improvement *winner = nullptr;
+
+  for (const WorkerState &state : states) {
+    result.evaluated += state.evaluated;
+    result.point_tests += state.point_tests;
+
+    const Improvement *best = nullptr;
+    for (const Improvement &improvement : state.improvements) {
+      if (improvement.hypothesis <= last) {
+        best = &improvement;
+      }
+    }
+
+    if (best != nullptr && (winner == nullptr || best->inliers > winner->inliers ||
+                            (best->inliers == winner->inliers && best->hypothesis < winner->hypothesis))) {
+      winner = best;
+    }
+  }
+
+  result.iterations = last + 1;
+
+  if (winner != nullptr && winner->inliers > 0) {
+    result.line = winner->line;
+    result.inliers = winner->inliers;
+    result.hypothesis = winner->hypothesis;
+    result.found = true;
+
+    // Final least-squares polish of the winner on its consensus set, kept even
+    // if a few borderline points leave the band
+    if (options.lo_iterations > 0) {
+      const LineModel &line = winner->line;
+      double bound = t * sqrt(line.a * line.a + line.b * line.b);
+      LineMoments m = inlier_moments(points.x(), points.y(), points.size(), line.a, line.b, line.c, bound, active.words());
+      LineModel polished;
+      if (fit_line(m, polished)) {
+        result.line = polished;
+        result.inliers = active.mask != nullptr
+          ? count_inliers_masked(points.x(), points.y(), points.size(), polished.a, polished.b, polished.c, t, active.words())
+          : count_inliers(points.x(), points.y(), points.size(), polished.a, polished.b, polished.c, t);
+      }
+    }
+  }
+
+  return result;
+}
@@ -0,0 +1,101 @@
+#ifndef __RANSAC_H__
+#define __RANSAC_H__
+
+#include "opencv2/opencv.hpp"
+#include "point_set.h"
+#include "consensus_mask.h"
+#include "inlier_kernel.h"
+#include <cstdint>
+#include <vector>
+
+// Line a * x + b * y + c = 0
+struct LineModel {
+  double a = 0.0;
+  double b = 0.0;
+  double c = 0.0;
+};
+
+// How a hypothesis is scored against the point set
+enum class Verification {
+  // Every point, in blocks. A hypothesis is dropped as soon as it can neither
+  // reach T nor beat the best count so far, which never changes the result.
+  FULL,
+  // T(d,d) pre-test: d random points must all be inliers before the full count
+  TDD,
+  // Wald's sequential probability ratio test over the points in random order
+  SPRT,
+};
+
+// How the two points of a hypothesis are drawn
+enum class Sampling {
+  UNIFORM,
+  // PROSAC: from growing prefixes of the points, which must come sorted by
+  // decreasing quality (see sort_by_quality)
+  PROSAC,
+  // NAPSAC: the second point from the grid neighborhood of the first
+  NAPSAC,
+};
+
+struct RansacOptions {
+  int threads = 0;       // 0 uses cv::getNumThreads()
+  uint64_t seed = 12345; // same seed, same result, for any thread count
+
+  Verification verification = Verification::FULL;
+  int tdd_d = 1;
+  // SPRT starting estimates, refined while running: inlier ratio of a good
+  // model, chance that a point agrees with a bad model, and the cost of
+  // generating a hypothesis measured in point evaluations
+  double sprt_epsilon = 0.3;
+  double sprt_delta = 0.05;
+  double sprt_model_cost = 200.0;
+
+  // Adaptive termination: N becomes an upper bound, and every improvement
+  // recomputes the number of hypotheses from the best inlier ratio so far and
+  // the chance that the sampler draws two of its inliers
+  bool adaptive = false;
+  double confidence = 0.99;
+  // LO-RANSAC: least-squares refits of every new best line to its consensus
+  // set, up to this many times while the set grows. 0 disables it.
+  int lo_iterations = 0;
+
+  // The points are already in random order, so SPRT can read them in place
+  // instead of working on a shuffled copy
+  bool shuffled_input = false;
+
+  Sampling sampling = Sampling::UNIFORM;
+  // Samples PROSAC spreads over the growing prefixes before it draws from the
+  // whole set like plain RANSAC (T_N in the paper)
+  int prosac_growth = 200000;
+  // NAPSAC grid cell size in pixels, 0 for 2 * t
+  double napsac_cell = 0.0;
+};
+
+struct RansacResult {
+  LineModel line;
+  int inliers = -1;
+  int hypothesis = -1; // index of the winning hypothesis
+  int iterations = 0;  // hypotheses the sequential loop would have needed
+  int evaluated = 0;   // hypotheses actually scored by all workers together
+  long long point_tests = 0; // point-line distance tests spent on verification
+  bool found = false;
+};
+
+// Parallel version of ransac_algorithm. Hypothesis i always draws its sample
+// from Philox stream (seed, i), and workers take hypotheses i = w, w + W, ...
+// The first hypothesis reaching T stops every worker; otherwise the best one
+// wins, ties going to the lowest index. The result is therefore exactly what a
+// sequential loop over the same streams would return. The randomized TDD and
+// SPRT verifications and LO keep it reproducible for a given seed and thread
+// count.
+// With an active mask only the marked points are sampled and scored, and the
+// inlier counts are counts among them.
+RansacResult ransac_parallel(const PointSet &points, double t, int T, int N,
+                             const RansacOptions &options = {}, const ConsensusMask *active = nullptr);
+RansacResult ransac_parallel(const std::vector<cv::Point2d> &points, double t, int T, int N,
+                             const RansacOptions &options = {});
+
+// Total least squares line through the moments of its points, with a unit
+// normal. Returns false for fewer than two points.
+bool fit_line(const LineMoments &m, LineModel &line);
+
+#endif // __RANSAC_H__
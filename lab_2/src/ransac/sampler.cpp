@@ -0,0 +1,320 @@
+#include "sampler.h"
+#include "inlier_kernel.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <numeric>
+
+using namespace cv;
+using namespace std;
+
+namespace {
+
+// Points in a minimal sample
+constexpr int kSampleSize = 2;
+
+// Hypotheses needed when each sample is all inliers with probability p
+int hypotheses_for(double p, double confidence, int cap)
+{
+  if (p >= 1.0) {
+    return 1;
+  }
+
+  double miss = log(1.0 - p);
+  if (miss >= 0.0) {
+    return cap;
+  }
+
+  double needed = ceil(log(1.0 - confidence) / miss);
+  return (int)min<double>(cap, max(1.0, needed));
+}
+
+} // namespace
+
+ActivePoints::ActivePoints(const PointSet &points, const ConsensusMask *mask)
+  :points(points), mask(mask), selector(mask != nullptr ? MaskSelector(*mask) : MaskSelector())
+{
+}
+
+Sampler::Sampler(const ActivePoints &active, const RansacOptions &options, double t, int N)
+  :active(active), sampling(options.sampling), beta(options.sprt_delta)
+{
+  const size_t n = active.size();
+
+  if (sampling != Sampling::UNIFORM && active.mask == nullptr) {
+    ConsensusMask everything(active.points.size(), true);
+    all.assign(everything.data(), everything.data() + everything.word_count());
+  }
+
+  if (sampling == Sampling::PROSAC && n > kSampleSize) {
+    // Growth function of Chum and Matas: T_n is the expected number of
+    // samples, out of prosac_growth uniform ones, drawn from the first n
+    // points only. T'_n rounds its increments up to whole hypotheses.
+    double tn = options.prosac_growth;
+    for (int i = 0; i < kSampleSize; i++) {
+      tn *= (double)(kSampleSize - i) / (n - i);
+    }
+
+    int until = 1;
+    prosac_until.push_back(until);
+    for (size_t m = kSampleSize; m < n && until <= N; m++) {
+      double next = tn * (m + 1) / (m + 1 - kSampleSize);
+      until += (int)ceil(next - tn);
+      tn = next;
+      prosac_until.push_back(until);
+    }
+  }
+
+  if (sampling == Sampling::NAPSAC && n > 0) {
+    double max_x = -INFINITY, max_y = -INFINITY;
+    min_x = INFINITY;
+    min_y = INFINITY;
+    for (size_t k = 0; k < n; k++) {
+      Point2d p = active[k];
+      min_x = min(min_x, p.x);
+      min_y = min(min_y, p.y);
+      max_x = max(max_x, p.x);
+      max_y = max(max_y, p.y);
+    }
+
+    // Keep the grid within a few cells per point for sparse sets
+    cell = options.napsac_cell > 0.0 ? options.napsac_cell : 2.0 * t;
+    double cells = ((max_x - min_x) / cell + 1.0) * ((max_y - min_y) / cell + 1.0);
+    if (cells > 4.0 * n + 64.0) {
+      cell *= sqrt(cells / (4.0 * n + 64.0));
+    }
+    grid_cols = (int)((max_x - min_x) / cell) + 1;
+    grid_rows = (int)((max_y - min_y) / cell) + 1;
+
+    // Counting sort of the points by cell
+    cell_start.assign((size_t)grid_cols * grid_rows + 1, 0);
+    for (size_t k = 0; k < n; k++) {
+      cell_start[cell_of(active[k]) + 1]++;
+    }
+    partial_sum(cell_start.begin(), cell_start.end(), cell_start.begin());
+
+    vector<uint32_t> fill(cell_start.begin(), cell_start.end() - 1);
+    cell_points.resize(n);
+    for (size_t k = 0; k < n; k++) {
+      size_t i = active.index(k);
+      cell_points[fill[cell_of(active.points[i])]++] = (uint32_t)i;
+    }
+  }
+}
+
+size_t Sampler::prosac_prefix(int h) const
+{
+  // Smallest n whose T'_n covers hypothesis h + 1
+  auto it = lower_bound(prosac_until.begin(), prosac_until.end(), h + 1);
+  if (it == prosac_until.end()) {
+    return active.size();
+  }
+  return kSampleSize + (it - prosac_until.begin());
+}
+
+int Sampler::cell_of(Point2d p) const
+{
+  int col = min(grid_cols - 1, (int)((p.x - min_x) / cell));
+  int row = min(grid_rows - 1, (int)((p.y - min_y) / cell));
+  return row * grid_cols + col;
+}
+
+void Sampler::sample(int h, Philox4x32 &rng, size_t &i1, size_t &i2) const
+{
+  const uint32_t n = (uint32_t)active.size();
+
+  if (sampling == Sampling::PROSAC && !prosac_until.empty()) {
+    // The newest point of the prefix and one of the points before it, until
+    // the prefix is the whole set
+    uint32_t prefix = (uint32_t)prosac_prefix(h);
+    if (prefix < n) {
+      i1 = active.index(rng.uniform(prefix - 1));
+      i2 = active.index(prefix - 1);
+      return;
+    }
+  }
+
+  uint32_t k1 = rng.uniform(n);
+  i1 = active.index(k1);
+
+  if (sampling == Sampling::NAPSAC && !cell_points.empty()) {
+    // A point of the 3 x 3 cells around the first one
+    int c = cell_of(active.points[i1]);
+    int row = c / grid_cols, col = c % grid_cols;
+    int r0 = max(0, row - 1), r1 = min(grid_rows - 1, row + 1);
+    int c0 = max(0, col - 1), c1 = min(grid_cols - 1, col + 1);
+
+    uint32_t total = 0;
+    for (int r = r0; r <= r1; r++) {
+      total += cell_start[r * grid_cols + c1 + 1] - cell_start[r * grid_cols + c0];
+    }
+
+    // An isolated point is paired uniformly instead
+    if (total > 1) {
+      uint32_t pick = rng.uniform(total - 1);
+      for (int r = r0; r <= r1; r++) {
+        uint32_t from = cell_start[r * grid_cols + c0];
+        uint32_t to = cell_start[r * grid_cols + c1 + 1];
+        for (uint32_t j = from; j < to; j++) {
+          if (cell_points[j] == i1) {
+            continue;
+          }
+          if (pick-- == 0) {
+            i2 = cell_points[j];
+            return;
+          }
+        }
+      }
+    }
+  }
+
+  uint32_t k2 = rng.uniform(n - 1);
+  if (k2 >= k1) {
+    k2++;
+  }
+  i2 = active.index(k2);
+}
+
+// Chance that a NAPSAC sample is all inliers: the first point is an inlier,
+// then the second is an inlier of its neighborhood
+double Sampler::napsac_success(const uint64_t *inliers, int count) const
+{
+  const size_t n = active.size();
+  const size_t cells = cell_start.size() - 1;
+
+  vector<uint32_t> cell_inliers(cells, 0);
+  for (size_t c = 0; c < cells; c++) {
+    for (uint32_t j = cell_start[c]; j < cell_start[c + 1]; j++) {
+      uint32_t i = cell_points[j];
+      cell_inliers[c] += (inliers[i / 64] >> (i % 64)) & 1;
+    }
+  }
+
+  double success = 0.0;
+  for (size_t c = 0; c < cells; c++) {
+    if (cell_inliers[c] == 0) {
+      continue;
+    }
+
+    int row = (int)c / grid_cols, col = (int)c % grid_cols;
+    double around = 0.0, around_inliers = 0.0;
+    for (int r = max(0, row - 1); r <= min(grid_rows - 1, row + 1); r++) {
+      for (int q = max(0, col - 1); q <= min(grid_cols - 1, col + 1); q++) {
+        around += cell_start[r * grid_cols + q + 1] - cell_start[r * grid_cols + q];
+        around_inliers += cell_inliers[r * grid_cols + q];
+      }
+    }
+
+    double second = around > 1.0 ? (around_inliers - 1.0) / (around - 1.0) : (count - 1.0) / (n - 1.0);
+    success += cell_inliers[c] * second;
+  }
+
+  return success / n;
+}
+
+// PROSAC termination: the first hypothesis after which some prefix of n ranks
+// has been sampled often enough for its inlier ratio. Only prefixes whose
+// inlier count is unlikely for a random line, with a point agreeing with one
+// at rate beta, count. The whole set is always a candidate.
+int Sampler::prosac_needed(const uint64_t *inliers, double confidence, int cap) const
+{
+  const uint64_t *words = active.mask != nullptr ? active.words() : all.data();
+  const size_t n = active.size();
+  const size_t word_count = (active.points.size() + 63) / 64;
+
+  int best = cap;
+  size_t rank = 0;
+  int count = 0;
+
+  for (size_t w = 0; w < word_count; w++) {
+    for (uint64_t bits = words[w]; bits != 0; bits &= bits - 1) {
+      rank++;
+      if (!((inliers[w] >> __builtin_ctzll(bits)) & 1)) {
+        continue;
+      }
+      count++;
+
+      // A prefix ending on an inlier has the best ratio among its neighbors
+      if (rank <= kSampleSize || count < kSampleSize) {
+        continue;
+      }
+      double spread = rank - kSampleSize;
+      double minimum = kSampleSize + beta * spread + 2.326 * sqrt(beta * (1.0 - beta) * spread);
+      if (count < minimum) {
+        continue;
+      }
+
+      double p = (double)count / rank * (count - 1.0) / (rank - 1.0);
+      int needed = hypotheses_for(p, confidence, cap);
+      size_t slot = rank - kSampleSize;
+      int drawn = rank >= n || slot >= prosac_until.size() ? INT_MAX : prosac_until[slot];
+      if (needed <= drawn) {
+        best = min(best, needed);
+      }
+    }
+  }
+
+  double p = (double)count / n * (count - 1.0) / (n - 1.0);
+  return min(best, hypotheses_for(p, confidence, cap));
+}
+
+int Sampler::hypotheses_needed(const LineModel &line, double t, int inliers, double confidence, int cap) const
+{
+  if (sampling == Sampling::UNIFORM || (sampling == Sampling::PROSAC && prosac_until.empty()) ||
+      (sampling == Sampling::NAPSAC && cell_points.empty())) {
+    double w = (double)inliers / active.size();
+    return hypotheses_for(w * w, confidence, cap);
+  }
+
+  // Inlier bits of the line among the active points
+  const PointSet &points = active.points;
+  const uint64_t *words = active.mask != nullptr ? active.words() : all.data();
+  vector<uint64_t> consensus((points.size() + 63) / 64);
+  double bound = t * sqrt(line.a * line.a + line.b * line.b);
+  int count = count_inliers_masked(points.x(), points.y(), points.size(), line.a, line.b, line.c, bound,
+                                   words, consensus.data());
+
+  if (sampling == Sampling::NAPSAC) {
+    return hypotheses_for(napsac_success(consensus.data(), count), confidence, cap);
+  }
+  return prosac_needed(consensus.data(), confidence, cap);
+}
+
+bool sample_line(const PointSet &points, const Sampler &sampler, int h, Philox4x32 &rng, LineModel &line)
+{
+  size_t i1, i2;
+  sampler.sample(h, rng, i1, i2);
+
+  const Point2d p1 = points[i1];
+  const Point2d p2 = points[i2];
+
+  if (p1.x == p2.x && p1.y == p2.y) {
+    return false;
+  }
+
+  line.a = p1.y - p2.y;
+  line.b = p2.x - p1.x;
+  line.c = p1.x * p2.y - p2.x * p1.y;
+
+  return true;
+}
+
+PointSet sort_by_quality(const PointSet &points, const vector<double> &quality, vector<uint32_t> *order)
+{
+  vector<uint32_t> perm(points.size());
+  iota(perm.begin(), perm.end(), 0u);
+  stable_sort(perm.begin(), perm.end(), [&](uint32_t i, uint32_t j) { return quality[i] > quality[j]; });
+
+  PointSet sorted;
+  sorted.resize(points.size());
+  for (size_t i = 0; i < perm.size(); i++) {
+    sorted.x()[i] = points.x()[perm[i]];
+    sorted.y()[i] = points.y()[perm[i]];
+  }
+
+  if (order != nullptr) {
+    *order = std::move(perm);
+  }
+  return sorted;
+}
@@ -0,0 +1,73 @@
+#ifndef __SAMPLER_H__
+#define __SAMPLER_H__
+
+#include "ransac.h"
+#include "philox.h"
+#include "consensus_mask.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// The points RANSAC runs on: the whole set, or the points of an active mask.
+// Active points are numbered by rank, in the order of the set.
+struct ActivePoints {
+  const PointSet &points;
+  const ConsensusMask *mask;
+  MaskSelector selector;
+
+  ActivePoints(const PointSet &points, const ConsensusMask *mask);
+
+  std::size_t size() const { return mask != nullptr ? selector.size() : points.size(); }
+  const uint64_t *words() const { return mask != nullptr ? mask->data() : nullptr; }
+
+  // Index in the set of the active point of rank k
+  std::size_t index(std::size_t k) const { return mask != nullptr ? selector.select(k) : k; }
+  cv::Point2d operator[](std::size_t k) const { return points[index(k)]; }
+};
+
+// Minimal samples for line hypotheses. Sample h depends only on h and its
+// Philox stream, so guided sampling keeps the parallel engine reproducible.
+// The sampler also knows how likely its samples are to be all inliers, which
+// is what adaptive termination needs.
+class Sampler {
+  const ActivePoints &active;
+  const Sampling sampling;
+  const double beta;
+  std::vector<uint64_t> all; // every point, when there is no active mask
+
+  // PROSAC: number of hypotheses drawn from the first n + 2 ranks at most
+  std::vector<int> prosac_until;
+
+  // NAPSAC: uniform grid over the active points, cell by cell
+  double cell = 0.0;
+  double min_x = 0.0, min_y = 0.0;
+  int grid_cols = 0, grid_rows = 0;
+  std::vector<uint32_t> cell_start;
+  std::vector<uint32_t> cell_points;
+
+  std::size_t prosac_prefix(int h) const;
+  int prosac_needed(const uint64_t *inliers, double confidence, int cap) const;
+  int cell_of(cv::Point2d p) const;
+  double napsac_success(const uint64_t *inliers, int count) const;
+
+public:
+  Sampler(const ActivePoints &active, const RansacOptions &options, double t, int N);
+
+  // Indices in the point set of the two points of hypothesis h
+  void sample(int h, Philox4x32 &rng, std::size_t &i1, std::size_t &i2) const;
+
+  // Hypotheses needed to draw, with the given confidence, one all-inlier
+  // sample of a line with this many inliers
+  int hypotheses_needed(const LineModel &line, double t, int inliers, double confidence, int cap) const;
+};
+
+// 4.a and 4.b: the two points of hypothesis h and the line through them.
+// Returns false for a degenerate sample.
+bool sample_line(const PointSet &points, const Sampler &sampler, int h, Philox4x32 &rng, LineModel &line);
+
+// The points sorted by decreasing quality, as PROSAC expects them. order
+// receives the index in the input of every sorted point.
+PointSet sort_by_quality(const PointSet &points, const std::vector<double> &quality,
+                         std::vector<uint32_t> *order = nullptr);
+
+#endif // __SAMPLER_H__
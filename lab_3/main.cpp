@@ -4,57 +4,162 @@
 #include "src/common/common.h"
 #include "src/slider/slider.h"
 #include "src/common/logger/logger.h"
+#include "src/hough/trig_table.h"
+#include "src/hough/line_voting.h"
+#include "src/hough/gradient.h"
+#include "src/hough/probabilistic.h"
+#include "src/hough/circles.h"
+#include "src/hough/peaks.h"
+#include "src/hough/half_plane.h"
+#include "src/hough/hierarchical.h"
+#include "src/hough/incremental.h"
+#include "src/hough/kernel.h"
+#include "src/hough/segments.h"
+#include "src/hough/batch.h"
+#include "src/edges/canny.h"
 
 using namespace cv;
 using namespace std;
 
-struct peak {
-    int theta, ro, hval;
+void perform_hough_algorithm(Mat_<uchar> edgeImg, const PointCoordinates<int>& edgePoints,
+                             const vector<float>& orientations, int windowSize, int k);
+void benchmark_voting(Mat_<uchar> edgeImg, int repeats);
+void perform_probabilistic_hough(Mat_<uchar> edgeImg);
+void perform_circle_hough(Mat_<uchar> edgeImg, Mat orientation);
+void perform_hierarchical_hough(Mat_<uchar> edgeImg, int k);
+void perform_kernel_hough(Mat_<uchar> edgeImg, int windowSize, int k);
+void perform_video_hough(const string& path, int windowSize, int k, bool compareFullVote);
+void perform_batch_hough(const string& directory, const string& outputPath, BatchFormat format);
+void draw_line(Mat& image, double ro, double thetaRad);
 
-    bool operator < (const peak& o) const {
-        return hval > o.hval;
+int main() {
+    // Follow the lines of a video instead, revoting only the edge pixels
+    // that change between frames. compareFullVote also votes every frame
+    // from scratch, to time it against the update and check that both give
+    // the same accumulator.
+    bool video = false;
+    bool compareFullVote = false;
+    if (video) {
+        perform_video_hough(PathConcat(VideoFolder, "/hough.mp4"), 3, 7, compareFullVote);
+        return 0;
     }
-};
 
-void perform_hough_algorithm(Mat_<uchar> edgeImg, int windowSize, int k);
+    // Find the lines of every edge map in a directory, without windows,
+    // writing them to a file
+    bool batch = false;
+    if (batch) {
+        perform_batch_hough("assets/images_Hough", EXPORT("hough_lines.json"), BatchFormat::JSON);
+        return 0;
+    }
 
-int main() {
-    // Step 1: read the image
-    Mat_<uchar> img = imread("assets/images_Hough/edge_simple.bmp", IMREAD_GRAYSCALE);
+    // Step 1: read the image, and find its edges unless they come prepared.
+    // The detector lists the edge points with their gradient directions.
+    bool detectEdges = true;
+    Mat_<uchar> img;
+    CannyEdges detected;
+    if (detectEdges) {
+        Mat_<uchar> source = imread("assets/images_Hough/image_simple.bmp", IMREAD_GRAYSCALE);
+        CannyOptions canny;
+        canny.low_threshold = 50;
+        canny.high_threshold = 150;
+        detected = canny_edges(source, canny);
+        img = detected.edges;
+    }
+    else {
+        img = imread("assets/images_Hough/edge_simple.bmp", IMREAD_GRAYSCALE);
+    }
+
+    // Time both parallel voting strategies on this image instead
+    bool benchmark = false;
+    if (benchmark) {
+        benchmark_voting(img, 20);
+        return 0;
+    }
 
     namedWindow("Original Image", WINDOW_KEEPRATIO);
     imshow("Original Image", img);
 
-    perform_hough_algorithm(img, 3, 7);
+    // Detect finite segments with the progressive probabilistic transform
+    // instead of infinite lines from the full accumulator
+    bool probabilistic = false;
+    if (probabilistic) {
+        perform_probabilistic_hough(img);
+        waitKey(0);
+        return 0;
+    }
+
+    // Refine the peaks of a coarse accumulator in small fine patches instead
+    // of voting into a fine accumulator over the whole plane
+    bool hierarchical = false;
+    if (hierarchical) {
+        perform_hierarchical_hough(img, 7);
+        waitKey(0);
+        return 0;
+    }
+
+    // Cast one Gaussian kernel vote per cluster of collinear edge pixels
+    // instead of one vote per pixel and angle
+    bool kernel = false;
+    if (kernel) {
+        perform_kernel_hough(img, 3, 7);
+        waitKey(0);
+        return 0;
+    }
+
+    // With the gradient directions of the source image, every edge point only
+    // votes for the lines along its edge
+    bool oriented = true;
+    Mat orientation;
+    if (oriented && detectEdges) {
+        orientation = detected.angles;
+    }
+    else if (oriented) {
+        Mat_<uchar> source = imread("assets/images_Hough/image_simple.bmp", IMREAD_GRAYSCALE);
+        orientation = gradient_orientation(source);
+    }
+
+    // Look for circles instead of lines, with the centers voted along the
+    // gradient directions
+    bool circles = false;
+    if (circles && !orientation.empty()) {
+        perform_circle_hough(img, orientation);
+        waitKey(0);
+        return 0;
+    }
+
+    PointCoordinates<int> edgePoints;
+    vector<float> orientations;
+    if (detectEdges) {
+        edgePoints = detected.points;
+        if (oriented) {
+            orientations = detected.orientations;
+        }
+    }
+    else {
+        edgePoints = extractPoints<int>(img, PixelPredicate::equal(255));
+        if (oriented) {
+            orientations = orientation_at(orientation, edgePoints);
+        }
+    }
+
+    perform_hough_algorithm(img, edgePoints, orientations, 3, 7);
 
     waitKey(0);
 
     return 0;
 }
 
-void perform_hough_algorithm(Mat_<uchar> edgeImg, int windowSize, int k) {
-    // Step 2: initialize the Hough accumulator
-    int width = edgeImg.cols;
-    int height = edgeImg.rows;
-
-    int diagonal = (int)round(sqrt(width * width + height * height));
-    Mat hough = Mat::zeros(diagonal + 1, 360, CV_32SC1);
-
-    // Step 3: fill in the accumulator
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            if (edgeImg(y, x) == 255) {
-                for (int theta = 0; theta < 360; theta++) {
-                    double thetaRad = theta * CV_PI / 180;
-                    int ro = round(x * cos(thetaRad) + y * sin(thetaRad));
-
-                    if (ro >= 0 && ro <= diagonal) {
-                        hough.at<int>(ro, theta)++;
-                    }
-                }
-            }
-        }
-    }
+void perform_hough_algorithm(Mat_<uchar> edgeImg, const PointCoordinates<int>& edgePoints,
+                             const vector<float>& orientations, int windowSize, int k) {
+    // Step 2 and 3: fill in the accumulator, theta over [0, 180) degrees
+    // with signed rho, in 16-bit cells as long as they cannot overflow
+    HalfPlaneOptions voting;
+    voting.theta_count = 180;
+    voting.rho_step = 1.0;
+    HalfPlaneAccumulator accumulator = orientations.empty()
+        ? vote_half_plane(edgePoints, edgeImg.size(), voting)
+        : vote_half_plane(edgePoints, orientations, edgeImg.size(), voting);
+    Mat hough = accumulator.votes;
 
     // Step 4: normalize and display the accumulator
     double maxHoughValue;
@@ -65,73 +170,286 @@ void perform_hough_algorithm(Mat_<uchar> edgeImg, int windowSize, int k) {
     namedWindow("Hough Accumulator", WINDOW_KEEPRATIO);
     imshow("Hough Accumulator", houghImg);
 
-    // Step 5: detect the local maxima
-    vector<peak> peaks;
-    int roDim = hough.rows;
-    int thetaDim = hough.cols;
-    int halfWindow = windowSize / 2;
+    // Step 5: detect the local maxima, keeping the k strongest
+    vector<HoughPeak> peaks = find_peaks(hough, windowSize, k);
+
+    // Step 6: walk the lines over the edges for their segments, draw them
+    // on the image and display the results
+    vector<HoughLine> lines;
+    for (HoughPeak peak : peaks) {
+        lines.push_back({ accumulator.rho(peak.rho), accumulator.theta(peak.theta), peak.votes });
+    }
 
-    for (int ro = halfWindow; ro < roDim - halfWindow; ro++) {
-        for (int theta = halfWindow; theta < thetaDim - halfWindow; theta++) {
-            int currentVal = hough.at<int>(ro, theta);
+    SegmentOptions options;
+    options.min_length = 20;
+    options.max_gap = 3;
+    options.tolerance = 1;
+    vector<LineSegment> segments = extract_segments(EdgeRuns(edgeImg), lines, options);
 
-            if (currentVal == 0) {
-                continue;
-            }
+    Mat detectedLines;
+    cvtColor(edgeImg, detectedLines, COLOR_GRAY2BGR);
 
-            bool isLocalMax = true;
+    for (const LineSegment& segment : segments) {
+        cout << "Segment (" << segment.start.x << ", " << segment.start.y << ") - ("
+             << segment.end.x << ", " << segment.end.y << ")" << endl;
+        line(detectedLines, segment.start, segment.end, Scalar(0, 255, 0), 1);
+    }
 
-            for (int i = -halfWindow; i <= halfWindow; i++) {
-                for (int j = -halfWindow; j <= halfWindow; j++) {
-                    if (hough.at<int>(ro + i, theta + j) > currentVal) {
-                        isLocalMax = false;
-                        break;
-                    }
-                }
+    namedWindow("Detected Lines", WINDOW_KEEPRATIO);
+    imshow("Detected Lines", detectedLines);
+}
 
-                if (!isLocalMax) {
-                    break;
-                }
-            }
+void benchmark_voting(Mat_<uchar> edgeImg, int repeats) {
+    int diagonal = (int)round(sqrt(edgeImg.cols * edgeImg.cols + edgeImg.rows * edgeImg.rows));
+    TrigTable angles(360, CV_PI / 180);
+    PointCoordinates<int> edgePoints = extractPoints<int>(edgeImg, PixelPredicate::equal(255));
 
-            if (isLocalMax) {
-                peaks.push_back({ theta, ro, currentVal });
+    cout << edgeImg.cols << " x " << edgeImg.rows << " image, " << edgePoints.size() << " edge points" << endl;
+
+    for (VoteStrategy strategy : { VoteStrategy::PRIVATE_ACCUMULATORS, VoteStrategy::THETA_PARTITION }) {
+        for (int threads = 1; threads <= getNumThreads(); threads *= 2) {
+            LineVotingOptions voting;
+            voting.strategy = strategy;
+            voting.threads = threads;
+
+            TickMeter timer;
+            timer.start();
+            for (int i = 0; i < repeats; i++) {
+                vote_lines(edgePoints, angles, diagonal + 1, voting);
             }
+            timer.stop();
+            double ms = timer.getTimeMilli() / repeats;
+
+            cout << (strategy == VoteStrategy::PRIVATE_ACCUMULATORS ? "private accumulators" : "theta partition")
+                 << ", " << threads << " threads: " << ms << " ms" << endl;
+        }
+    }
+
+    for (int threads = 1; threads <= getNumThreads(); threads *= 2) {
+        HalfPlaneOptions voting;
+        voting.threads = threads;
+
+        TickMeter timer;
+        timer.start();
+        for (int i = 0; i < repeats; i++) {
+            vote_half_plane(edgePoints, edgeImg.size(), voting);
         }
+        timer.stop();
+
+        cout << "half plane, " << threads << " threads: " << timer.getTimeMilli() / repeats << " ms" << endl;
     }
+}
+
+void perform_probabilistic_hough(Mat_<uchar> edgeImg) {
+    // Half a turn of angles, as rho is signed
+    TrigTable angles(180, CV_PI / 180);
+
+    ProbabilisticOptions options;
+    options.threshold = 30;
+    options.min_length = 20;
+    options.max_gap = 3;
+
+    vector<LineSegment> segments = probabilistic_hough(edgeImg, angles, options);
 
-    sort(peaks.begin(), peaks.end());
+    Mat detectedSegments;
+    cvtColor(edgeImg, detectedSegments, COLOR_GRAY2BGR);
 
-    if (peaks.size() > k) {
-        peaks.resize(k);
+    for (const LineSegment& segment : segments) {
+        cout << "Segment (" << segment.start.x << ", " << segment.start.y << ") - ("
+             << segment.end.x << ", " << segment.end.y << ")" << endl;
+        line(detectedSegments, segment.start, segment.end, Scalar(0, 255, 0), 1);
     }
 
-    // Step 6: draw the lines on the image and display the results
+    namedWindow("Detected Segments", WINDOW_KEEPRATIO);
+    imshow("Detected Segments", detectedSegments);
+}
+
+void perform_circle_hough(Mat_<uchar> edgeImg, Mat orientation) {
+    PointCoordinates<int> edgePoints = extractPoints<int>(edgeImg, PixelPredicate::equal(255));
+
+    CircleOptions options;
+    options.min_radius = 5;
+    options.center_threshold = 20;
+    options.min_coverage = 0.5;
+
+    vector<Circle> circles = hough_circles(edgePoints, orientation_at(orientation, edgePoints), edgeImg.size(), options);
+
+    Mat detectedCircles;
+    cvtColor(edgeImg, detectedCircles, COLOR_GRAY2BGR);
+
+    for (const Circle& circle : circles) {
+        cout << "Circle at (" << circle.center.x << ", " << circle.center.y << ") with radius " << circle.radius
+             << ", " << circle.support << " edge points" << endl;
+        cv::circle(detectedCircles, circle.center, circle.radius, Scalar(0, 255, 0), 1);
+    }
+
+    namedWindow("Detected Circles", WINDOW_KEEPRATIO);
+    imshow("Detected Circles", detectedCircles);
+}
+
+void perform_hierarchical_hough(Mat_<uchar> edgeImg, int k) {
+    PointCoordinates<int> edgePoints = extractPoints<int>(edgeImg, PixelPredicate::equal(255));
+
+    // 2 degree by 4 pixel coarse cells, refined to 0.1 degree by 0.5 pixel
+    HierarchicalOptions options;
+    options.coarse_theta_count = 90;
+    options.coarse_rho_step = 4.0;
+    options.fine_theta_step = 0.1 * CV_PI / 180;
+    options.fine_rho_step = 0.5;
+
+    vector<HoughLine> lines = hierarchical_hough(edgePoints, edgeImg.size(), k, options);
+
     Mat detectedLines;
     cvtColor(edgeImg, detectedLines, COLOR_GRAY2BGR);
 
-    for (peak peak : peaks) {
-        double ro = peak.ro;
-        double thetaRad = peak.theta * CV_PI / 180.0;
+    for (const HoughLine& line : lines) {
+        cout << "Line rho " << line.rho << ", theta " << line.theta * 180 / CV_PI << " degrees, "
+             << line.votes << " votes" << endl;
+        draw_line(detectedLines, line.rho, line.theta);
+    }
+
+    namedWindow("Detected Lines", WINDOW_KEEPRATIO);
+    imshow("Detected Lines", detectedLines);
+}
 
-        double a = cos(thetaRad);
-        double b = sin(thetaRad);
+void perform_kernel_hough(Mat_<uchar> edgeImg, int windowSize, int k) {
+    PointCoordinates<int> edgePoints = extractPoints<int>(edgeImg, PixelPredicate::equal(255));
 
-        double x0 = a * ro;
-        double y0 = b * ro;
+    KernelOptions options;
+    options.min_cluster = 10;
+    options.max_deviation = 1.0;
 
-        Point2d pt1;
-        Point2d pt2;
+    TickMeter timer;
+    timer.start();
+    vector<EdgeCluster> clusters = edge_clusters(edgePoints, edgeImg.size(), options);
+    HalfPlaneAccumulator accumulator = vote_kernels(clusters, edgeImg.size(), options);
+    vector<HoughPeak> peaks = find_peaks(accumulator.votes, windowSize, k);
+    timer.stop();
 
-        pt1.x = cvRound(x0 + 1000 * (-b));
-        pt1.y = cvRound(y0 + 1000 * (a));
+    cout << edgePoints.size() << " edge points in " << clusters.size() << " clusters, "
+         << timer.getTimeMilli() << " ms" << endl;
 
-        pt2.x = cvRound(x0 - 1000 * (-b));
-        pt2.y = cvRound(y0 - 1000 * (a));
+    Mat detectedLines;
+    cvtColor(edgeImg, detectedLines, COLOR_GRAY2BGR);
 
-        line(detectedLines, pt1, pt2, Scalar(0, 255, 0), 1);
+    for (HoughPeak peak : peaks) {
+        draw_line(detectedLines, accumulator.rho(peak.rho), accumulator.theta(peak.theta));
     }
 
     namedWindow("Detected Lines", WINDOW_KEEPRATIO);
     imshow("Detected Lines", detectedLines);
 }
+
+void perform_video_hough(const string& path, int windowSize, int k, bool compareFullVote) {
+    VideoCapture capture(path);
+    if (!capture.isOpened()) {
+        ERROR("Could not open video {}.", path);
+        return;
+    }
+
+    Mat frame, gray;
+    capture >> frame;
+    if (frame.empty()) {
+        return;
+    }
+
+    IncrementalHough hough(frame.size());
+    namedWindow("Detected Lines", WINDOW_KEEPRATIO);
+
+    int frames = 0, mismatches = 0;
+    double updateMs = 0, fullMs = 0;
+
+    for (; !frame.empty(); capture >> frame) {
+        cvtColor(frame, gray, COLOR_BGR2GRAY);
+        CannyEdges detected = canny_edges(gray);
+
+        TickMeter timer;
+        timer.start();
+        size_t changed = hough.update(detected.edges);
+        const HalfPlaneAccumulator& accumulator = hough.accumulator();
+        vector<HoughPeak> peaks = find_peaks(accumulator.votes, windowSize, k);
+        timer.stop();
+
+        cout << changed << " edge pixels changed, " << timer.getTimeMilli() << " ms" << endl;
+
+        if (compareFullVote) {
+            TickMeter fullTimer;
+            fullTimer.start();
+            HalfPlaneAccumulator full = vote_half_plane(detected.points, frame.size());
+            find_peaks(full.votes, windowSize, k);
+            fullTimer.stop();
+
+            // The cells may differ in width, not in count
+            Mat updated, voted;
+            accumulator.votes.convertTo(updated, CV_32S);
+            full.votes.convertTo(voted, CV_32S);
+            bool same = updated.size() == voted.size() && norm(updated, voted, NORM_INF) == 0;
+
+            frames++;
+            mismatches += !same;
+            updateMs += timer.getTimeMilli();
+            fullMs += fullTimer.getTimeMilli();
+            cout << "    full revote " << fullTimer.getTimeMilli() << " ms, " << (same ? "same" : "different")
+                 << " accumulator" << endl;
+        }
+
+        for (HoughPeak peak : peaks) {
+            draw_line(frame, accumulator.rho(peak.rho), accumulator.theta(peak.theta));
+        }
+
+        imshow("Detected Lines", frame);
+        if (waitKey(1) == 27) {
+            break;
+        }
+    }
+
+    if (frames > 0) {
+        cout << frames << " frames: " << updateMs / frames << " ms per update against " << fullMs / frames
+             << " ms per full revote, " << mismatches << " accumulators differed" << endl;
+    }
+}
+
+void perform_batch_hough(const string& directory, const string& outputPath, BatchFormat format) {
+    ofstream output(outputPath);
+    if (!output) {
+        ERROR("Could not open {} for writing.", outputPath);
+        return;
+    }
+
+    // The same steps as perform_hough_algorithm, one image per thread
+    BatchOptions options;
+    options.voting.theta_count = 180;
+    options.voting.rho_step = 1.0;
+    options.window = 3;
+    options.k = 7;
+    // The photos next to the edge maps get the same thresholds as image_simple.bmp
+    options.canny.low_threshold = 50;
+    options.canny.high_threshold = 150;
+    options.format = format;
+
+    BatchReport report = run_batch(directory, output, options);
+
+    cout << report.images << " images (" << report.failed << " unreadable, " << report.photos
+         << " run through Canny first) in " << report.seconds << " s, "
+         << report.images_per_second() << " images/sec on " << getNumThreads() << " threads, "
+         << report.allocations << " accumulators made" << endl;
+}
+
+void draw_line(Mat& image, double ro, double thetaRad) {
+    double a = cos(thetaRad);
+    double b = sin(thetaRad);
+
+    double x0 = a * ro;
+    double y0 = b * ro;
+
+    Point2d pt1;
+    Point2d pt2;
+
+    pt1.x = cvRound(x0 + 1000 * (-b));
+    pt1.y = cvRound(y0 + 1000 * (a));
+
+    pt2.x = cvRound(x0 - 1000 * (-b));
+    pt2.y = cvRound(y0 - 1000 * (a));
+
+    line(image, pt1, pt2, Scalar(0, 255, 0), 1);
+}
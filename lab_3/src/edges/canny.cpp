@@ -0,0 +1,279 @@
+#include "canny.h"
+#include "../common/logger/logger.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+namespace {
+
+// States of the pixels after non-maximum suppression
+enum : uchar {
+  kNone = 0,
+  kWeak = 1, // local maximum above the low threshold
+  kEdge = 2, // above the high threshold, or connected to such a pixel
+};
+
+// tan(22.5 degrees) in Q15
+constexpr int kTan22 = 13573;
+
+// Index i of a line of n values, reflected at the ends like
+// cv::BORDER_REFLECT_101
+inline int reflect(int i, int n)
+{
+  if (n == 1) {
+    return 0;
+  }
+  while (i < 0 || i >= n) {
+    i = i < 0 ? -i : 2 * n - 2 - i;
+  }
+  return i;
+}
+
+// Row buffers of one band
+struct Rows {
+  int cols;
+  std::vector<int32_t> smooth, derive; // vertical passes, with 3 reflected values on each side
+  // Gradient rows y - 1, y and y + 1 in turn, the magnitude with a zero on
+  // each side so the neighbors of the border columns are not maxima
+  std::vector<int32_t> dx[3], dy[3], mag[3];
+
+  explicit Rows(int cols) : cols(cols), smooth(cols + 6), derive(cols + 6)
+  {
+    for (int k = 0; k < 3; k++) {
+      dx[k].resize(cols);
+      dy[k].resize(cols);
+      mag[k].assign(cols + 2, 0);
+    }
+  }
+};
+
+// Sobel derivatives of the binomially smoothed image at row y, in Sobel
+// units, and |dx| + |dy|. The two 5-tap binomials and the 3-tap Sobel
+// kernels combine into [1 6 15 20 15 6 1] to smooth and [-1 -4 -5 0 5 4 1]
+// to differentiate, 256 times too large.
+void gradient_row(const cv::Mat &image, int y, Rows &rows, int slot)
+{
+  const int cols = rows.cols;
+  const uchar *r[7];
+  for (int k = 0; k < 7; k++) {
+    r[k] = image.ptr<uchar>(reflect(y + k - 3, image.rows));
+  }
+
+  int32_t *smooth = rows.smooth.data() + 3;
+  int32_t *derive = rows.derive.data() + 3;
+
+#pragma omp simd
+  for (int c = 0; c < cols; c++) {
+    int32_t a = r[0][c], b = r[1][c], d = r[2][c], e = r[3][c], f = r[4][c], g = r[5][c], h = r[6][c];
+    smooth[c] = (a + h) + 6 * (b + g) + 15 * (d + f) + 20 * e;
+    derive[c] = (h - a) + 4 * (g - b) + 5 * (f - d);
+  }
+
+  for (int k = 1; k <= 3; k++) {
+    smooth[-k] = smooth[reflect(-k, cols)];
+    derive[-k] = derive[reflect(-k, cols)];
+    smooth[cols - 1 + k] = smooth[reflect(cols - 1 + k, cols)];
+    derive[cols - 1 + k] = derive[reflect(cols - 1 + k, cols)];
+  }
+
+  int32_t *dx = rows.dx[slot].data();
+  int32_t *dy = rows.dy[slot].data();
+  int32_t *mag = rows.mag[slot].data() + 1;
+  const int32_t *s = smooth - 3;
+  const int32_t *v = derive - 3;
+
+#pragma omp simd
+  for (int c = 0; c < cols; c++) {
+    int32_t gx = (s[c + 6] - s[c]) + 4 * (s[c + 5] - s[c + 1]) + 5 * (s[c + 4] - s[c + 2]);
+    int32_t gy = (v[c] + v[c + 6]) + 6 * (v[c + 1] + v[c + 5]) + 15 * (v[c + 2] + v[c + 4]) + 20 * v[c + 3];
+    gx = (gx + 128) >> 8;
+    gy = (gy + 128) >> 8;
+    dx[c] = gx;
+    dy[c] = gy;
+    mag[c] = std::abs(gx) + std::abs(gy);
+  }
+}
+
+// Gradient direction in [0, 2 pi), measured like the Hough theta
+inline float direction(int32_t gx, int32_t gy)
+{
+  float angle = std::atan2((float)gy, (float)gx);
+  return angle < 0 ? angle + (float)(2 * CV_PI) : angle;
+}
+
+// Non-maximum suppression of row y from the gradient rows around it
+void suppress_row(const Rows &rows, int above, int here, int below, int low, int high, uchar *state, float *angles)
+{
+  const int32_t *dx = rows.dx[here].data();
+  const int32_t *dy = rows.dy[here].data();
+  const int32_t *up = rows.mag[above].data() + 1;
+  const int32_t *mag = rows.mag[here].data() + 1;
+  const int32_t *down = rows.mag[below].data() + 1;
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+
+  for (int c = 0; c < rows.cols; c++) {
+    const int32_t m = mag[c];
+    state[c] = kNone;
+    angles[c] = nan;
+    if (m <= low) {
+      continue;
+    }
+
+    const int32_t ax = std::abs(dx[c]), ay = std::abs(dy[c]);
+    const int32_t tan22 = ax * kTan22;
+    const int32_t scaled = ay << 15;
+    bool maximum;
+
+    if (scaled < tan22) {
+      maximum = m > mag[c - 1] && m >= mag[c + 1];
+    }
+    else if (scaled > tan22 + (ax << 16)) {
+      maximum = m > up[c] && m >= down[c];
+    }
+    else {
+      int s = (dx[c] ^ dy[c]) < 0 ? -1 : 1;
+      maximum = m > up[c - s] && m >= down[c + s];
+    }
+
+    if (maximum) {
+      state[c] = m > high ? kEdge : kWeak;
+      angles[c] = direction(dx[c], dy[c]);
+    }
+  }
+}
+
+// Gradient and suppression of rows [y0, y1)
+void suppress_band(const cv::Mat &image, int y0, int y1, int low, int high, cv::Mat &state, cv::Mat &angles)
+{
+  Rows rows(image.cols);
+  auto slot = [](int y) { return (y % 3 + 3) % 3; };
+
+  // Rows outside of the image keep a zero magnitude
+  for (int y = y0 - 1; y <= y1; y++) {
+    if (y >= 0 && y < image.rows) {
+      gradient_row(image, y, rows, slot(y));
+    }
+    else {
+      std::fill(rows.mag[slot(y)].begin(), rows.mag[slot(y)].end(), 0);
+    }
+
+    if (y - 1 >= y0) {
+      suppress_row(rows, slot(y - 2), slot(y - 1), slot(y), low, high, state.ptr<uchar>(y - 1),
+                   angles.ptr<float>(y - 1));
+    }
+  }
+}
+
+// Promotes the weak pixels 8-connected to the ones on the stack, within
+// rows [y0, y1)
+void fill(cv::Mat &state, std::vector<cv::Point> &stack, int y0, int y1)
+{
+  while (!stack.empty()) {
+    cv::Point p = stack.back();
+    stack.pop_back();
+
+    for (int y = std::max(y0, p.y - 1); y <= std::min(y1 - 1, p.y + 1); y++) {
+      uchar *row = state.ptr<uchar>(y);
+      for (int x = std::max(0, p.x - 1); x <= std::min(state.cols - 1, p.x + 1); x++) {
+        if (row[x] == kWeak) {
+          row[x] = kEdge;
+          stack.push_back(cv::Point(x, y));
+        }
+      }
+    }
+  }
+}
+
+} // namespace
+
+CannyEdges canny_edges(const cv::Mat &image, const CannyOptions &options)
+{
+  CannyEdges result;
+
+  if (image.type() != CV_8UC1 || image.empty()) {
+    ERROR("Canny edge detection needs an 8-bit grayscale image. Returning no edges.");
+    return result;
+  }
+
+  const int rows = image.rows;
+  const int cols = image.cols;
+  cv::Mat state(rows, cols, CV_8UC1);
+  result.angles = cv::Mat(rows, cols, CV_32FC1);
+  result.edges = cv::Mat(rows, cols, CV_8UC1);
+
+  int workers = options.threads > 0 ? options.threads : cv::getNumThreads();
+  workers = std::max(1, std::min(workers, rows));
+  auto band = [&](int w) { return cv::Range(rows * w / workers, rows * (w + 1) / workers); };
+
+  // Gradient, suppression and hysteresis within each band
+  cv::parallel_for_(cv::Range(0, workers), [&](const cv::Range &range) {
+    for (int w = range.start; w < range.end; w++) {
+      cv::Range b = band(w);
+      suppress_band(image, b.start, b.end, options.low_threshold, options.high_threshold, state, result.angles);
+
+      std::vector<cv::Point> stack;
+      for (int y = b.start; y < b.end; y++) {
+        const uchar *row = state.ptr<uchar>(y);
+        for (int x = 0; x < cols; x++) {
+          if (row[x] == kEdge) {
+            stack.push_back(cv::Point(x, y));
+          }
+        }
+      }
+      fill(state, stack, b.start, b.end);
+    }
+  }, workers);
+
+  // Chains that cross bands go on from the edges on the band borders
+  std::vector<cv::Point> stack;
+  for (int w = 1; w < workers; w++) {
+    for (int y : { band(w).start - 1, band(w).start }) {
+      const uchar *row = state.ptr<uchar>(y);
+      for (int x = 0; x < cols; x++) {
+        if (row[x] == kEdge) {
+          stack.push_back(cv::Point(x, y));
+        }
+      }
+    }
+  }
+  fill(state, stack, 0, rows);
+
+  // Edge map, and the edge pixels of each band listed in order
+  std::vector<PointCoordinates<int>> points(workers);
+  std::vector<std::vector<float>> orientations(workers);
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+
+  cv::parallel_for_(cv::Range(0, workers), [&](const cv::Range &range) {
+    for (int w = range.start; w < range.end; w++) {
+      cv::Range b = band(w);
+      for (int y = b.start; y < b.end; y++) {
+        const uchar *row = state.ptr<uchar>(y);
+        uchar *edges = result.edges.ptr<uchar>(y);
+        float *angles = result.angles.ptr<float>(y);
+
+        for (int x = 0; x < cols; x++) {
+          if (row[x] == kEdge) {
+            edges[x] = 255;
+            points[w].x.push_back(x);
+            points[w].y.push_back(y);
+            orientations[w].push_back(angles[x]);
+          }
+          else {
+            edges[x] = 0;
+            angles[x] = nan;
+          }
+        }
+      }
+    }
+  }, workers);
+
+  for (int w = 0; w < workers; w++) {
+    result.points.x.insert(result.points.x.end(), points[w].x.begin(), points[w].x.end());
+    result.points.y.insert(result.points.y.end(), points[w].y.begin(), points[w].y.end());
+    result.orientations.insert(result.orientations.end(), orientations[w].begin(), orientations[w].end());
+  }
+
+  return result;
+}
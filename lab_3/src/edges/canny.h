@@ -0,0 +1,38 @@
+#ifndef __EDGES_CANNY_H__
+#define __EDGES_CANNY_H__
+
+#include "opencv2/opencv.hpp"
+#include "../common/points/point_extractor.h"
+#include <vector>
+
+struct CannyOptions {
+  // Hysteresis thresholds on |dx| + |dy|, the Sobel derivatives of the
+  // smoothed image, as for cv::Canny
+  int low_threshold = 50;
+  int high_threshold = 150;
+  int threads = 0; // 0 uses cv::getNumThreads()
+};
+
+struct CannyEdges {
+  cv::Mat edges;  // CV_8UC1, 255 on the edges
+  cv::Mat angles; // CV_32FC1 gradient direction in [0, 2 pi) on the edges, NaN elsewhere
+  PointCoordinates<int> points;    // the edge pixels in row-major order
+  std::vector<float> orientations; // their gradient directions, as vote_lines takes them
+};
+
+// Canny edges of an 8-bit grayscale image, with the edge pixels and their
+// gradient directions listed as the Hough transforms take them, so no pass
+// over the edge map is needed to find them.
+//
+// The image is smoothed with the 5 x 5 binomial approximation of a Gaussian
+// (sigma about 1) and differentiated with 3 x 3 Sobel kernels in one pass:
+// both are separable, so each derivative is a 7-tap vertical and a 7-tap
+// horizontal integer convolution, run as vectorized loops over whole rows.
+// Non-maximum suppression follows in the same pass, over the gradient
+// direction quantized to 45 degrees, and hysteresis then keeps the weak
+// maxima connected to strong ones. Everything runs over bands of rows in
+// parallel, with a final serial fill for the chains that cross bands.
+// Borders are reflected like cv::BORDER_REFLECT_101.
+CannyEdges canny_edges(const cv::Mat &image, const CannyOptions &options = {});
+
+#endif // __EDGES_CANNY_H__
@@ -0,0 +1,281 @@
+#include "batch.h"
+#include "peaks.h"
+#include "../common/logger/logger.h"
+#include "../common/points/point_extractor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdint>
+#include <filesystem>
+#include <fmt/format.h>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace {
+
+struct ImageResult {
+  std::string file;
+  bool read = false;
+  cv::Size size;
+  bool photo = false; // edges found with Canny
+  std::size_t points = 0;
+  std::vector<HoughLine> lines;
+  std::vector<LineSegment> segments;
+};
+
+// What a worker keeps from one image to the next
+struct Worker {
+  HalfPlaneAccumulator acc;
+  EdgeRuns runs;
+};
+
+bool is_image(const std::filesystem::path &path)
+{
+  std::string extension = path.extension().string();
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+                 [](unsigned char c) { return (char)std::tolower(c); });
+  for (const char *known : { ".bmp", ".png", ".jpg", ".jpeg", ".pgm", ".pbm", ".tif", ".tiff" }) {
+    if (extension == known) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Whether every pixel is 0 or 255. Rows are checked without a branch per
+// pixel, so the loop vectorizes.
+bool is_edge_map(const cv::Mat &image)
+{
+  for (int y = 0; y < image.rows; y++) {
+    const uchar *row = image.ptr<uchar>(y);
+    int other = 0;
+    for (int x = 0; x < image.cols; x++) {
+      other |= (uchar)(row[x] - 1) < 254;
+    }
+    if (other) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// A cleared accumulator for the image, the one of the last image when it
+// fits. Cells are 16-bit as long as no cell can overflow them.
+void clear_accumulator(Worker &worker, cv::Size size, std::size_t points, const HalfPlaneOptions &voting,
+                       std::size_t &allocations)
+{
+  const int type = points <= UINT16_MAX ? CV_16UC1 : CV_32SC1;
+  HalfPlaneAccumulator &acc = worker.acc;
+
+  if (!acc.votes.empty() && acc.size == size && acc.votes.type() == type) {
+    acc.votes.setTo(0);
+    return;
+  }
+
+  acc = vote_half_plane(PointCoordinates<int>(), size, voting);
+  if (type == CV_32SC1 && !acc.votes.empty()) {
+    acc.votes = cv::Mat::zeros(acc.votes.rows, acc.votes.cols, CV_32SC1);
+  }
+  allocations++;
+}
+
+void detect(Worker &worker, const cv::Mat &image, const BatchOptions &options, ImageResult &result,
+            std::size_t &allocations)
+{
+  cv::Mat edges = image;
+  PointCoordinates<int> points;
+  if (is_edge_map(image)) {
+    points = extractPoints<int>(edges, PixelPredicate::notEqual(0));
+  }
+  else {
+    CannyOptions canny = options.canny;
+    canny.threads = 1;
+    CannyEdges detected = canny_edges(image, canny);
+    edges = detected.edges;
+    points = std::move(detected.points);
+    result.photo = true;
+  }
+
+  result.size = edges.size();
+  result.points = points.size();
+
+  clear_accumulator(worker, edges.size(), points.size(), options.voting, allocations);
+  if (worker.acc.votes.empty()) {
+    return;
+  }
+  update_half_plane(worker.acc, points, 1, 1);
+
+  for (HoughPeak peak : find_peaks(worker.acc.votes, options.window, options.k)) {
+    result.lines.push_back({ worker.acc.rho(peak.rho), worker.acc.theta(peak.theta), peak.votes });
+  }
+
+  if (options.segments) {
+    SegmentOptions segment_options = options.segment_options;
+    segment_options.threads = 1;
+    worker.runs.assign(edges);
+    result.segments = extract_segments(worker.runs, result.lines, segment_options);
+  }
+}
+
+std::string json_string(const std::string &text)
+{
+  std::string quoted = "\"";
+  for (unsigned char c : text) {
+    if (c == '"' || c == '\\') {
+      quoted += '\\';
+      quoted += (char)c;
+    }
+    else if (c < 0x20) {
+      quoted += fmt::format("\\u{:04x}", c);
+    }
+    else {
+      quoted += (char)c;
+    }
+  }
+  return quoted + "\"";
+}
+
+std::string csv_field(const std::string &text)
+{
+  if (text.find_first_of(",\"\r\n") == std::string::npos) {
+    return text;
+  }
+  std::string quoted = "\"";
+  for (char c : text) {
+    quoted += c == '"' ? "\"\"" : std::string(1, c);
+  }
+  return quoted + "\"";
+}
+
+void write_json(std::ostream &out, const ImageResult &result, bool first)
+{
+  out << (first ? "\n  " : ",\n  ") << "{\"file\": " << json_string(result.file);
+  if (!result.read) {
+    out << ", \"error\": \"unreadable\"}";
+    return;
+  }
+
+  out << ", \"edges\": " << (result.photo ? "\"canny\"" : "\"input\"");
+  out << ", \"width\": " << result.size.width << ", \"height\": " << result.size.height
+      << ", \"edge_points\": " << result.points << ", \"lines\": [";
+  for (std::size_t i = 0; i < result.lines.size(); i++) {
+    const HoughLine &line = result.lines[i];
+    out << (i ? ", " : "") << fmt::format("{{\"rho\": {}, \"theta\": {:.6f}, \"votes\": {}}}", line.rho, line.theta,
+                                          line.votes);
+  }
+  out << "], \"segments\": [";
+  for (std::size_t i = 0; i < result.segments.size(); i++) {
+    const LineSegment &segment = result.segments[i];
+    out << (i ? ", " : "") << "[" << segment.start.x << ", " << segment.start.y << ", " << segment.end.x << ", "
+        << segment.end.y << "]";
+  }
+  out << "]}";
+}
+
+void write_csv(std::ostream &out, const ImageResult &result)
+{
+  const std::string file = csv_field(result.file);
+  if (!result.read) {
+    out << file << ",error,,,,,,,,\n";
+    return;
+  }
+
+  for (std::size_t i = 0; i < result.lines.size(); i++) {
+    const HoughLine &line = result.lines[i];
+    out << file << ",line," << i << "," << line.rho << "," << fmt::format("{:.6f}", line.theta) << ","
+        << line.votes << ",,,,\n";
+  }
+  for (std::size_t i = 0; i < result.segments.size(); i++) {
+    const LineSegment &segment = result.segments[i];
+    out << file << ",segment," << i << ",,,," << segment.start.x << "," << segment.start.y << "," << segment.end.x
+        << "," << segment.end.y << "\n";
+  }
+}
+
+} // namespace
+
+BatchReport run_batch(const std::string &directory, std::ostream &out, const BatchOptions &options)
+{
+  BatchReport report;
+
+  std::error_code error;
+  std::vector<std::filesystem::path> files;
+  for (const auto &entry : std::filesystem::directory_iterator(directory, error)) {
+    if (entry.is_regular_file() && is_image(entry.path())) {
+      files.push_back(entry.path());
+    }
+  }
+  if (error) {
+    ERROR("Could not list directory {}: {}. Processing no images.", directory, error.message());
+    return report;
+  }
+  std::sort(files.begin(), files.end());
+
+  if (options.format == BatchFormat::JSON) {
+    out << "[";
+  }
+  else {
+    out << "file,kind,index,rho,theta,votes,x0,y0,x1,y1\n";
+  }
+
+  const int count = (int)files.size();
+  int workers = options.threads > 0 ? options.threads : cv::getNumThreads();
+  workers = std::max(1, std::min(workers, count));
+
+  // Results wait here until every earlier one is written
+  std::vector<std::optional<ImageResult>> done(count);
+  std::atomic<int> next(0);
+  std::mutex output;
+  int written = 0;
+
+  cv::TickMeter timer;
+  timer.start();
+
+  cv::parallel_for_(cv::Range(0, workers), [&](const cv::Range &range) {
+    for (int w = range.start; w < range.end; w++) {
+      Worker worker;
+      std::size_t allocations = 0;
+
+      for (int i = next++; i < count; i = next++) {
+        ImageResult result;
+        result.file = files[i].filename().string();
+
+        cv::Mat image = cv::imread(files[i].string(), cv::IMREAD_GRAYSCALE);
+        if (!image.empty()) {
+          result.read = true;
+          detect(worker, image, options, result, allocations);
+        }
+
+        std::lock_guard<std::mutex> lock(output);
+        done[i] = std::move(result);
+        for (; written < count && done[written]; written++) {
+          if (options.format == BatchFormat::JSON) {
+            write_json(out, *done[written], written == 0);
+          }
+          else {
+            write_csv(out, *done[written]);
+          }
+          report.failed += !done[written]->read;
+          report.photos += done[written]->photo;
+          done[written].reset();
+        }
+      }
+
+      std::lock_guard<std::mutex> lock(output);
+      report.allocations += allocations;
+    }
+  }, workers);
+
+  timer.stop();
+
+  if (options.format == BatchFormat::JSON) {
+    out << (count ? "\n]\n" : "]\n");
+  }
+  out.flush();
+
+  report.images = count;
+  report.seconds = timer.getTimeSec();
+  return report;
+}
@@ -0,0 +1,54 @@
+#ifndef __HOUGH_BATCH_H__
+#define __HOUGH_BATCH_H__
+
+#include "opencv2/opencv.hpp"
+#include "half_plane.h"
+#include "segments.h"
+#include "../edges/canny.h"
+#include <cstddef>
+#include <ostream>
+#include <string>
+
+enum class BatchFormat {
+  JSON, // one array, an object per image
+  CSV,  // a row per line and per segment
+};
+
+struct BatchOptions {
+  HalfPlaneOptions voting; // its threads are ignored, each image votes on one
+  int window = 3;          // peak suppression window
+  int k = 7;               // lines per image
+  bool segments = true;    // also walk the lines for their segments
+  SegmentOptions segment_options;
+  CannyOptions canny; // its threads are ignored too
+  BatchFormat format = BatchFormat::JSON;
+  int threads = 0; // images in flight, 0 uses cv::getNumThreads()
+};
+
+struct BatchReport {
+  std::size_t images = 0;
+  std::size_t failed = 0;      // could not be read
+  std::size_t photos = 0;      // not edge maps, so their edges were found first
+  std::size_t allocations = 0; // accumulators made, only when a worker meets a new image size or cell width
+  double seconds = 0;
+
+  double images_per_second() const { return seconds > 0 ? images / seconds : 0; }
+};
+
+// Finds the lines of every image in a directory, in file name order, the
+// way perform_hough_algorithm does for one: half-plane voting, the k
+// strongest peaks, and optionally their segments. Results go to out as they
+// complete, in file order. An image with only 0 and 255 pixels is an edge
+// map whose non-zero pixels are the edges; any other is a photo, whose edges
+// are found with canny_edges first, so edge maps and the photos they came
+// from can share a directory.
+//
+// Each worker takes the next image, decodes, votes, finds the peaks and
+// walks the segments on its own, so the stages of different images overlap
+// and throughput grows with the workers. A worker keeps its accumulator
+// across images and clears it instead of making a new one while the image
+// size stays the same. Whichever worker completes the next image due for
+// output writes every result ready in order.
+BatchReport run_batch(const std::string &directory, std::ostream &out, const BatchOptions &options = {});
+
+#endif // __HOUGH_BATCH_H__
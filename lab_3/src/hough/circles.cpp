@@ -0,0 +1,167 @@
+#include "circles.h"
+#include "../common/logger/logger.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace {
+
+constexpr int kShift = 16;
+
+// Saturating 16-bit counters over a width x height grid, stored in 32 x 32
+// tiles of 2 KB
+class TiledCounters {
+  static constexpr int kTileShift = 5;
+  static constexpr int kTileMask = (1 << kTileShift) - 1;
+
+  int tiles_x;
+  std::vector<uint16_t> cells;
+
+  std::size_t index(int x, int y) const
+  {
+    std::size_t tile = (std::size_t)(y >> kTileShift) * tiles_x + (x >> kTileShift);
+    return (tile << (2 * kTileShift)) | ((y & kTileMask) << kTileShift) | (x & kTileMask);
+  }
+
+public:
+  TiledCounters(int width, int height)
+    :tiles_x((width + kTileMask) >> kTileShift),
+     cells((std::size_t)tiles_x * ((height + kTileMask) >> kTileShift) << (2 * kTileShift), 0)
+  {
+  }
+
+  void vote(int x, int y)
+  {
+    uint16_t &count = cells[index(x, y)];
+    count += count != UINT16_MAX;
+  }
+
+  int at(int x, int y) const { return cells[index(x, y)]; }
+};
+
+// Votes of point (x, y) for the centers at distances [min_radius,
+// max_radius] along direction (c, s), both ways. The walk takes one pixel
+// per step along the major axis, the other coordinate in Q16, so no cell
+// gets two votes from the same point.
+void vote_centers(TiledCounters &acc, int x, int y, double c, double s, int min_radius, int max_radius,
+                  int width, int height)
+{
+  const double major = std::max(std::abs(c), std::abs(s));
+  const int32_t dx = (int32_t)std::lround(c / major * (1 << kShift));
+  const int32_t dy = (int32_t)std::lround(s / major * (1 << kShift));
+  const int first = (int)std::ceil(min_radius * major);
+  const int last = (int)std::floor(max_radius * major);
+
+  for (int sign : { 1, -1 }) {
+    int32_t px = (x << kShift) + (1 << (kShift - 1)) + sign * first * dx;
+    int32_t py = (y << kShift) + (1 << (kShift - 1)) + sign * first * dy;
+
+    // The image is convex, so a ray that leaves it never comes back
+    for (int k = first; k <= last; k++, px += sign * dx, py += sign * dy) {
+      int cx = px >> kShift, cy = py >> kShift;
+      if ((unsigned)cx >= (unsigned)width || (unsigned)cy >= (unsigned)height) {
+        break;
+      }
+      acc.vote(cx, cy);
+    }
+  }
+}
+
+struct Candidate {
+  int x, y, votes;
+};
+
+} // namespace
+
+std::vector<Circle> hough_circles(const PointCoordinates<int> &points, const std::vector<float> &orientations,
+                                  cv::Size size, const CircleOptions &options)
+{
+  std::vector<Circle> circles;
+
+  if (orientations.size() != points.size()) {
+    ERROR("Circle detection needs one orientation per point. Returning no circles.");
+    return circles;
+  }
+
+  const int width = size.width;
+  const int height = size.height;
+  const int min_radius = std::max(1, options.min_radius);
+  const int max_radius = options.max_radius > 0 ? options.max_radius : std::min(width, height) / 2;
+  if (width <= 0 || height <= 0 || max_radius < min_radius) {
+    return circles;
+  }
+
+  // Stage 1: centers along the gradients
+  TiledCounters acc(width, height);
+  for (std::size_t i = 0; i < points.size(); i++) {
+    if (!std::isnan(orientations[i])) {
+      vote_centers(acc, points.x[i], points.y[i], std::cos(orientations[i]), std::sin(orientations[i]),
+                   min_radius, max_radius, width, height);
+    }
+  }
+
+  // Local maxima, ties broken towards the top left cell
+  std::vector<Candidate> candidates;
+  for (int y = 1; y < height - 1; y++) {
+    for (int x = 1; x < width - 1; x++) {
+      int votes = acc.at(x, y);
+      if (votes >= options.center_threshold && votes > acc.at(x - 1, y) && votes >= acc.at(x + 1, y) &&
+          votes > acc.at(x, y - 1) && votes >= acc.at(x, y + 1)) {
+        candidates.push_back({ x, y, votes });
+      }
+    }
+  }
+  std::stable_sort(candidates.begin(), candidates.end(),
+                   [](const Candidate &a, const Candidate &b) { return a.votes > b.votes; });
+
+  // Stage 2: a radius histogram per center, over the rows the circle spans
+  std::vector<int> histogram(max_radius + 3);
+  const double min_distance2 = (double)options.min_distance * options.min_distance;
+
+  for (const Candidate &candidate : candidates) {
+    bool crowded = std::any_of(circles.begin(), circles.end(), [&](const Circle &circle) {
+      double dx = circle.center.x - candidate.x, dy = circle.center.y - candidate.y;
+      return dx * dx + dy * dy < min_distance2;
+    });
+    if (crowded) {
+      continue;
+    }
+
+    std::fill(histogram.begin(), histogram.end(), 0);
+    auto from = std::lower_bound(points.y.begin(), points.y.end(), candidate.y - max_radius - 1);
+    auto to = std::upper_bound(points.y.begin(), points.y.end(), candidate.y + max_radius + 1);
+
+    for (std::size_t i = from - points.y.begin(); i < (std::size_t)(to - points.y.begin()); i++) {
+      int dx = points.x[i] - candidate.x, dy = points.y[i] - candidate.y;
+      int r = (int)std::lround(std::sqrt((double)(dx * dx + dy * dy)));
+      if (r >= min_radius - 1 && r <= max_radius + 1) {
+        histogram[r]++;
+      }
+    }
+
+    // The radius whose circle is best covered by edge points. A digital
+    // edge spreads over two neighboring distance bins, so the support of r
+    // takes in r - 1 and r + 1 as well.
+    int best = 0, best_support = 0;
+    double best_coverage = 0.0;
+    for (int r = min_radius; r <= max_radius; r++) {
+      int support = histogram[r - 1] + histogram[r] + histogram[r + 1];
+      double coverage = support / (2 * CV_PI * r);
+      if (coverage > best_coverage) {
+        best_coverage = coverage;
+        best = r;
+        best_support = support;
+      }
+    }
+
+    if (best_coverage >= options.min_coverage) {
+      circles.push_back({ cv::Point(candidate.x, candidate.y), best, best_support });
+      if (options.max_circles > 0 && (int)circles.size() >= options.max_circles) {
+        break;
+      }
+    }
+  }
+
+  return circles;
+}
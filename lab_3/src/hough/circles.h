@@ -0,0 +1,38 @@
+#ifndef __HOUGH_CIRCLES_H__
+#define __HOUGH_CIRCLES_H__
+
+#include "opencv2/opencv.hpp"
+#include "../common/points/point_extractor.h"
+#include <vector>
+
+struct CircleOptions {
+  int min_radius = 5;
+  int max_radius = 0;        // 0 for half the smaller image side
+  int center_threshold = 20; // votes a center needs
+  int min_distance = 10;     // between the centers of two circles
+  double min_coverage = 0.5; // part of the circumference that must be edge points
+  int max_circles = 0;       // 0 for no limit
+};
+
+struct Circle {
+  cv::Point center;
+  int radius;
+  int support; // edge points within 1.5 pixels of the circle
+};
+
+// Circle Hough transform in two stages over 2D accumulators only, so memory
+// is O(W H) instead of O(W H R):
+// 1. every edge point votes for the centers along its gradient direction,
+//    both ways, at distances [min_radius, max_radius], into an image-sized
+//    grid of saturating 16-bit counters kept in 32 x 32 tiles so that the
+//    short runs of votes stay within a few cache lines;
+// 2. local maxima of that grid, strongest first, get a radius histogram of
+//    the edge points around them, and the best radius becomes a circle if
+//    its support covers min_coverage of the circumference.
+// points come in row-major order, as the point extractor gives them, with
+// their gradient directions as gradient_orientation gives them; points with
+// a NaN direction do not vote for centers. Circles come strongest first.
+std::vector<Circle> hough_circles(const PointCoordinates<int> &points, const std::vector<float> &orientations,
+                                  cv::Size size, const CircleOptions &options = {});
+
+#endif // __HOUGH_CIRCLES_H__
@@ -0,0 +1,34 @@
+#include "gradient.h"
+
+#include <limits>
+
+cv::Mat gradient_orientation(const cv::Mat &image, int ksize)
+{
+  cv::Mat dx, dy, orientation;
+  cv::Sobel(image, dx, CV_32F, 1, 0, ksize);
+  cv::Sobel(image, dy, CV_32F, 0, 1, ksize);
+  cv::phase(dx, dy, orientation);
+
+  for (int i = 0; i < orientation.rows; i++) {
+    const float *gx = dx.ptr<float>(i);
+    const float *gy = dy.ptr<float>(i);
+    float *angle = orientation.ptr<float>(i);
+
+    for (int j = 0; j < orientation.cols; j++) {
+      if (gx[j] == 0.0f && gy[j] == 0.0f) {
+        angle[j] = std::numeric_limits<float>::quiet_NaN();
+      }
+    }
+  }
+
+  return orientation;
+}
+
+std::vector<float> orientation_at(const cv::Mat &orientation, const PointCoordinates<int> &points)
+{
+  std::vector<float> angles(points.size());
+  for (std::size_t i = 0; i < points.size(); i++) {
+    angles[i] = orientation.at<float>(points.y[i], points.x[i]);
+  }
+  return angles;
+}
@@ -0,0 +1,17 @@
+#ifndef __HOUGH_GRADIENT_H__
+#define __HOUGH_GRADIENT_H__
+
+#include "opencv2/opencv.hpp"
+#include "../common/points/point_extractor.h"
+#include <vector>
+
+// Gradient direction of a grayscale image from its Sobel derivatives, as a
+// CV_32FC1 map of angles in [0, 2 pi) radians measured like the Hough theta
+// (x right, y down). Where both derivatives vanish the direction is
+// undefined and the map holds NaN.
+cv::Mat gradient_orientation(const cv::Mat &image, int ksize = 3);
+
+// The orientation map at every point, as vote_lines takes it
+std::vector<float> orientation_at(const cv::Mat &orientation, const PointCoordinates<int> &points);
+
+#endif // __HOUGH_GRADIENT_H__
@@ -0,0 +1,297 @@
+#include "half_plane.h"
+#include "trig_table.h"
+#include "../common/logger/logger.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <cstdint>
+
+namespace {
+
+// cos / rho_step and sin / rho_step in Q16, and the Q16 offset that makes
+// every rho a row index and rounds it
+struct ScaledTable {
+  std::vector<int32_t> cosq;
+  std::vector<int32_t> sinq;
+  int32_t bias;
+};
+
+// The points, and for oriented voting their gradient directions and the
+// half-width of the angle window around them, in table steps
+struct VoteInput {
+  const int *xs;
+  const int *ys;
+  const float *orientations = nullptr;
+  int half_window = 0;
+};
+
+// How a vote changes a cell
+enum class Count {
+  ADD,
+  ADD_SATURATED, // stops at the largest value of the cell type
+  REMOVE,
+};
+
+template <typename T>
+struct VoteTarget {
+  T *cells;
+  int32_t step; // in cells
+};
+
+// Votes of point (x, y) for angles [t0, t1)
+template <typename T, Count kCount>
+__attribute__((always_inline)) inline void vote_point(int32_t x, int32_t y, int t0, int t1, const ScaledTable &table,
+                                                      const VoteTarget<T> &target, int32_t *offsets)
+{
+  const int32_t *cosq = table.cosq.data();
+  const int32_t *sinq = table.sinq.data();
+  const int32_t bias = table.bias;
+  const int32_t step = target.step;
+
+#pragma omp simd
+  for (int t = t0; t < t1; t++) {
+    offsets[t - t0] = ((x * cosq[t] + y * sinq[t] + bias) >> TrigTable::kFractionBits) * step + t;
+  }
+
+  for (int t = 0; t < t1 - t0; t++) {
+    T &cell = target.cells[offsets[t]];
+    if constexpr (kCount == Count::ADD_SATURATED) {
+      cell += cell != std::numeric_limits<T>::max();
+    }
+    else if constexpr (kCount == Count::REMOVE) {
+      cell--;
+    }
+    else {
+      cell++;
+    }
+  }
+}
+
+// Parts of [t0, t1) within half_window steps of the orientation modulo half
+// a turn, at most two ranges
+inline int window_ranges(float orientation, int count, double theta_step, int half_window, int t0, int t1,
+                         int *ranges)
+{
+  if (std::isnan(orientation) || 2 * half_window + 1 >= count) {
+    ranges[0] = t0;
+    ranges[1] = t1;
+    return 1;
+  }
+
+  const int center = (int)std::lround(orientation / theta_step);
+  const int lo = ((center - half_window) % count + count) % count;
+  const int hi = lo + 2 * half_window + 1;
+
+  int pieces[2][2] = { { lo, std::min(hi, count) }, { 0, hi - count } };
+  int parts = 0;
+  for (const int *piece : pieces) {
+    int a = std::max(piece[0], t0);
+    int b = std::min(piece[1], t1);
+    if (a < b) {
+      ranges[2 * parts] = a;
+      ranges[2 * parts + 1] = b;
+      parts++;
+    }
+  }
+  return parts;
+}
+
+template <typename T, Count kCount>
+__attribute__((always_inline)) inline void vote_points(const VoteInput &input, std::size_t n,
+                                                       const ScaledTable &table, double theta_step, int t0, int t1,
+                                                       const VoteTarget<T> &target, int32_t *offsets)
+{
+  if (input.orientations == nullptr) {
+    for (std::size_t i = 0; i < n; i++) {
+      vote_point<T, kCount>(input.xs[i], input.ys[i], t0, t1, table, target, offsets);
+    }
+    return;
+  }
+
+  const int count = (int)table.cosq.size();
+  int ranges[4];
+  for (std::size_t i = 0; i < n; i++) {
+    int parts = window_ranges(input.orientations[i], count, theta_step, input.half_window, t0, t1, ranges);
+    for (int k = 0; k < parts; k++) {
+      vote_point<T, kCount>(input.xs[i], input.ys[i], ranges[2 * k], ranges[2 * k + 1], table, target, offsets);
+    }
+  }
+}
+
+template <typename T, Count kCount>
+void vote_points_default(const VoteInput &input, std::size_t n, const ScaledTable &table, double theta_step,
+                         int t0, int t1, const VoteTarget<T> &target, int32_t *offsets)
+{
+  vote_points<T, kCount>(input, n, table, theta_step, t0, t1, target, offsets);
+}
+
+template <typename T, Count kCount>
+__attribute__((target("avx2")))
+void vote_points_avx2(const VoteInput &input, std::size_t n, const ScaledTable &table, double theta_step,
+                      int t0, int t1, const VoteTarget<T> &target, int32_t *offsets)
+{
+  vote_points<T, kCount>(input, n, table, theta_step, t0, t1, target, offsets);
+}
+
+bool has_avx2()
+{
+  static const bool avx2 = [] {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+  }();
+  return avx2;
+}
+
+template <typename T, Count kCount>
+void vote_all(const VoteInput &input, std::size_t n, const ScaledTable &table, double theta_step, int threads,
+              cv::Mat &votes)
+{
+  const int count = votes.cols;
+  VoteTarget<T> target = { votes.ptr<T>(0), (int32_t)(votes.step / sizeof(T)) };
+
+  // Whole cache lines of cells per worker
+  const int lanes = 64 / sizeof(T);
+  int workers = threads > 0 ? threads : cv::getNumThreads();
+  workers = std::max(1, std::min(workers, (count + lanes - 1) / lanes));
+  const int chunk = ((count + workers - 1) / workers + lanes - 1) / lanes * lanes;
+
+  cv::parallel_for_(cv::Range(0, workers), [&](const cv::Range &range) {
+    for (int w = range.start; w < range.end; w++) {
+      int t0 = std::min(count, w * chunk);
+      int t1 = std::min(count, t0 + chunk);
+      if (t0 >= t1) {
+        continue;
+      }
+
+      std::vector<int32_t> offsets(t1 - t0);
+      if (has_avx2()) {
+        vote_points_avx2<T, kCount>(input, n, table, theta_step, t0, t1, target, offsets.data());
+      }
+      else {
+        vote_points_default<T, kCount>(input, n, table, theta_step, t0, t1, target, offsets.data());
+      }
+    }
+  }, workers);
+}
+
+ScaledTable scaled_table(const HalfPlaneAccumulator &acc)
+{
+  const int count = acc.votes.cols;
+  TrigTable angles(count, acc.theta_step);
+  const double scale = (double)(1 << TrigTable::kFractionBits) / acc.rho_step;
+
+  ScaledTable table = { std::vector<int32_t>(count), std::vector<int32_t>(count),
+                        (acc.rho_offset << TrigTable::kFractionBits) + TrigTable::kHalf };
+  for (int t = 0; t < count; t++) {
+    table.cosq[t] = (int32_t)std::lround(angles.cos(t) * scale);
+    table.sinq[t] = (int32_t)std::lround(angles.sin(t) * scale);
+  }
+  return table;
+}
+
+bool inside(const VoteInput &input, std::size_t n, cv::Size size)
+{
+  for (std::size_t i = 0; i < n; i++) {
+    if (input.xs[i] < 0 || input.xs[i] >= size.width || input.ys[i] < 0 || input.ys[i] >= size.height) {
+      ERROR("Point ({}, {}) is outside the {} x {} image.", input.xs[i], input.ys[i], size.width, size.height);
+      return false;
+    }
+  }
+  return true;
+}
+
+HalfPlaneAccumulator vote(VoteInput input, std::size_t n, cv::Size size, const HalfPlaneOptions &options)
+{
+  HalfPlaneAccumulator acc;
+
+  if (options.theta_count <= 0 || !(options.rho_step > 0) || size.width <= 0 || size.height <= 0) {
+    ERROR("The half-plane accumulator needs a positive size, angle count and rho step. Returning an empty accumulator.");
+    return acc;
+  }
+
+  // One spare row each way for the rounding of the fixed-point tables. The
+  // biased Q16 rho must stay below 2^31.
+  const int rho_offset = (int)std::ceil(std::hypot(size.width, size.height) / options.rho_step) + 1;
+  if (rho_offset >= (1 << (30 - TrigTable::kFractionBits))) {
+    ERROR("The half-plane accumulator is limited to 16383 rho rows on each side. Returning an empty accumulator.");
+    return acc;
+  }
+
+  if (!inside(input, n, size)) {
+    return acc;
+  }
+
+  acc.size = size;
+  acc.rho_offset = rho_offset;
+  acc.rho_step = options.rho_step;
+  acc.theta_step = CV_PI / options.theta_count;
+  input.half_window = (int)std::floor(options.angle_window / acc.theta_step);
+
+  // No cell gets more votes than there are points
+  const bool narrow = n <= UINT16_MAX || options.saturate;
+  acc.votes = cv::Mat::zeros(2 * rho_offset + 1, options.theta_count, narrow ? CV_16UC1 : CV_32SC1);
+  ScaledTable table = scaled_table(acc);
+
+  if (!narrow) {
+    vote_all<int32_t, Count::ADD>(input, n, table, acc.theta_step, options.threads, acc.votes);
+  }
+  else if (n > UINT16_MAX) {
+    vote_all<uint16_t, Count::ADD_SATURATED>(input, n, table, acc.theta_step, options.threads, acc.votes);
+  }
+  else {
+    vote_all<uint16_t, Count::ADD>(input, n, table, acc.theta_step, options.threads, acc.votes);
+  }
+
+  return acc;
+}
+
+} // namespace
+
+HalfPlaneAccumulator vote_half_plane(const PointCoordinates<int> &points, cv::Size size,
+                                     const HalfPlaneOptions &options)
+{
+  VoteInput input = { points.x.data(), points.y.data() };
+  return vote(input, points.size(), size, options);
+}
+
+HalfPlaneAccumulator vote_half_plane(const PointCoordinates<int> &points, const std::vector<float> &orientations,
+                                     cv::Size size, const HalfPlaneOptions &options)
+{
+  if (orientations.size() != points.size()) {
+    ERROR("Oriented half-plane voting needs one orientation per point. Returning an empty accumulator.");
+    return HalfPlaneAccumulator();
+  }
+
+  VoteInput input = { points.x.data(), points.y.data(), orientations.data() };
+  return vote(input, points.size(), size, options);
+}
+
+void update_half_plane(HalfPlaneAccumulator &acc, const PointCoordinates<int> &points, int sign, int threads)
+{
+  if (acc.votes.empty() || (sign != 1 && sign != -1)) {
+    ERROR("Updating a half-plane accumulator needs one made by vote_half_plane and a sign of 1 or -1.");
+    return;
+  }
+
+  VoteInput input = { points.x.data(), points.y.data() };
+  if (points.empty() || !inside(input, points.size(), acc.size)) {
+    return;
+  }
+
+  ScaledTable table = scaled_table(acc);
+  if (acc.votes.type() == CV_32SC1) {
+    if (sign > 0) {
+      vote_all<int32_t, Count::ADD>(input, points.size(), table, acc.theta_step, threads, acc.votes);
+    }
+    else {
+      vote_all<int32_t, Count::REMOVE>(input, points.size(), table, acc.theta_step, threads, acc.votes);
+    }
+  }
+  else if (sign > 0) {
+    vote_all<uint16_t, Count::ADD>(input, points.size(), table, acc.theta_step, threads, acc.votes);
+  }
+  else {
+    vote_all<uint16_t, Count::REMOVE>(input, points.size(), table, acc.theta_step, threads, acc.votes);
+  }
+}
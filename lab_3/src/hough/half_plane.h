@@ -0,0 +1,58 @@
+#ifndef __HOUGH_HALF_PLANE_H__
+#define __HOUGH_HALF_PLANE_H__
+
+#include "opencv2/opencv.hpp"
+#include "../common/points/point_extractor.h"
+#include <vector>
+
+struct HalfPlaneOptions {
+  int theta_count = 180; // angles over [0, pi)
+  double rho_step = 1.0; // pixels per rho row
+  // Keep 16-bit cells past 65535 points, saturating instead of switching to
+  // 32-bit ones
+  bool saturate = false;
+  int threads = 0; // 0 uses cv::getNumThreads()
+  // With orientations, how far from its gradient direction a point still
+  // votes, in radians
+  double angle_window = 5 * CV_PI / 180;
+};
+
+// Line accumulator over theta in [0, pi) and signed rho. Row r, column t
+// counts the points with round((x cos + y sin) / rho_step) == r - rho_offset
+// for theta = t theta_step.
+struct HalfPlaneAccumulator {
+  cv::Mat votes; // CV_16UC1, or CV_32SC1 when a cell could pass 65535
+  cv::Size size; // of the image
+  int rho_offset = 0;
+  double rho_step = 1.0;
+  double theta_step = 0.0;
+
+  double rho(int row) const { return (row - rho_offset) * rho_step; }
+  double theta(int column) const { return column * theta_step; }
+};
+
+// Votes of the points of an image of the given size for the lines through
+// them. A line (theta + pi, rho) is line (theta, -rho), so half a turn of
+// angles with signed rho covers every line once: each point casts half the
+// votes of a [0, 2 pi) accumulator with rho >= 0, none of them out of range.
+// With at most 65535 points no cell can overflow 16 bits, which halves the
+// accumulator again; a 640 x 480 image needs 1603 x 180 cells, 564 KB.
+//
+// The angles are split between threads as in VoteStrategy::THETA_PARTITION,
+// in whole cache lines of cells.
+HalfPlaneAccumulator vote_half_plane(const PointCoordinates<int> &points, cv::Size size,
+                                     const HalfPlaneOptions &options = {});
+
+// vote_half_plane where point i only votes for the angles within
+// options.angle_window of orientations[i] modulo pi, as in the oriented
+// vote_lines. Points with a NaN orientation vote for every angle.
+HalfPlaneAccumulator vote_half_plane(const PointCoordinates<int> &points, const std::vector<float> &orientations,
+                                     cv::Size size, const HalfPlaneOptions &options = {});
+
+// Adds the votes of the points to an accumulator from vote_half_plane, or
+// takes them back with sign -1, as if it had been voted with or without
+// them. Cells wrap around instead of saturating, so remove only points that
+// voted before, and keep to 32-bit cells when one could pass 65535.
+void update_half_plane(HalfPlaneAccumulator &acc, const PointCoordinates<int> &points, int sign, int threads = 0);
+
+#endif // __HOUGH_HALF_PLANE_H__
@@ -0,0 +1,211 @@
+#include "hierarchical.h"
+#include "half_plane.h"
+#include "peaks.h"
+#include "trig_table.h"
+#include "../common/logger/logger.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// The coarse accumulator with half columns on each side taken from the
+// other end of the theta range, where (theta +- pi, rho) is (theta, -rho):
+// the columns come over with their rows reversed, as row r holds rho
+// (r - rho_offset) step and the rows are symmetric around rho_offset
+cv::Mat wrap_theta(const cv::Mat &votes, int half)
+{
+  const int rows = votes.rows;
+  const int cols = votes.cols;
+  const std::size_t size = votes.elemSize();
+  cv::Mat wrapped = cv::Mat::zeros(rows, cols + 2 * half, votes.type());
+
+  for (int r = 0; r < rows; r++) {
+    const uchar *row = votes.ptr<uchar>(r);
+    const uchar *mirror = votes.ptr<uchar>(rows - 1 - r);
+    uchar *out = wrapped.ptr<uchar>(r);
+
+    std::memcpy(out, mirror + (cols - half) * size, half * size);
+    std::memcpy(out + half * size, row, cols * size);
+    std::memcpy(out + (half + cols) * size, mirror, half * size);
+  }
+  return wrapped;
+}
+
+// Fine accumulator around one coarse peak
+struct Patch {
+  double theta0, rho0; // first column and row
+  int theta_count, rho_count;
+};
+
+// The strongest cell of the patch, the first one on ties, as a line with
+// theta in [0, pi), and whether it lies on the border of the patch
+HoughLine refine(const PointCoordinates<int> &points, const Patch &patch, const HierarchicalOptions &options,
+                 bool &border)
+{
+  const double theta1 = patch.theta0 + (patch.theta_count - 1) * options.fine_theta_step;
+  const double theta_mid = (patch.theta0 + theta1) / 2;
+  const double rho1 = patch.rho0 + patch.rho_count * options.fine_rho_step;
+
+  // rho in rows of the patch, in Q16 with the rounding folded into the bias
+  TrigTable angles(patch.theta_count, options.fine_theta_step, patch.theta0);
+  const double scale = (double)(1 << TrigTable::kFractionBits) / options.fine_rho_step;
+  std::vector<int32_t> cosq(patch.theta_count), sinq(patch.theta_count);
+  for (int t = 0; t < patch.theta_count; t++) {
+    cosq[t] = (int32_t)std::lround(angles.cos(t) * scale);
+    sinq[t] = (int32_t)std::lround(angles.sin(t) * scale);
+  }
+  const int32_t bias = (int32_t)std::lround(-patch.rho0 * scale) + TrigTable::kHalf;
+
+  const double c0 = std::cos(patch.theta0), s0 = std::sin(patch.theta0);
+  const double c1 = std::cos(theta1), s1 = std::sin(theta1);
+  const double cm = std::cos(theta_mid), sm = std::sin(theta_mid);
+
+  std::vector<int> votes((std::size_t)patch.theta_count * patch.rho_count, 0);
+  std::vector<int32_t> rows(patch.theta_count);
+
+  for (std::size_t i = 0; i < points.size(); i++) {
+    const int x = points.x[i], y = points.y[i];
+
+    // Over a few degrees the sinusoid of the point is close to monotonic,
+    // so its ends and middle bound the rho it takes in the patch
+    double r0 = x * c0 + y * s0, r1 = x * c1 + y * s1, rm = x * cm + y * sm;
+    if (std::max({ r0, r1, rm }) < patch.rho0 || std::min({ r0, r1, rm }) > rho1) {
+      continue;
+    }
+
+#pragma omp simd
+    for (int t = 0; t < patch.theta_count; t++) {
+      rows[t] = (x * cosq[t] + y * sinq[t] + bias) >> TrigTable::kFractionBits;
+    }
+    for (int t = 0; t < patch.theta_count; t++) {
+      if ((unsigned)rows[t] < (unsigned)patch.rho_count) {
+        votes[(std::size_t)rows[t] * patch.theta_count + t]++;
+      }
+    }
+  }
+
+  std::size_t best = std::max_element(votes.begin(), votes.end()) - votes.begin();
+  int row = (int)(best / patch.theta_count), column = (int)(best % patch.theta_count);
+  border = row == 0 || row == patch.rho_count - 1 || column == 0 || column == patch.theta_count - 1;
+
+  return { patch.rho0 + row * options.fine_rho_step, angles.angle(column), votes[best] };
+}
+
+// Refines a coarse peak. A maximum on the border of the patch is the slope
+// of a peak outside of it, so the patch moves on to center there, for a few
+// steps; a line is kept only once its maximum is inside the patch.
+HoughLine climb(const PointCoordinates<int> &points, Patch patch, const HierarchicalOptions &options)
+{
+  const int kSteps = 4;
+
+  for (int step = 0; step < kSteps; step++) {
+    bool border;
+    HoughLine line = refine(points, patch, options, border);
+    if (!border) {
+      if (line.theta < 0) {
+        line.theta += CV_PI;
+        line.rho = -line.rho;
+      }
+      else if (line.theta >= CV_PI) {
+        line.theta -= CV_PI;
+        line.rho = -line.rho;
+      }
+      return line;
+    }
+
+    patch.theta0 = line.theta - patch.theta_count / 2 * options.fine_theta_step;
+    patch.rho0 = line.rho - patch.rho_count / 2 * options.fine_rho_step;
+  }
+
+  return { 0.0, 0.0, 0 };
+}
+
+} // namespace
+
+std::vector<HoughLine> hierarchical_hough(const PointCoordinates<int> &points, cv::Size size, int k,
+                                          const HierarchicalOptions &options)
+{
+  if (k <= 0) {
+    return {};
+  }
+  if (!(options.fine_theta_step > 0) || !(options.fine_rho_step > 0)) {
+    ERROR("Hierarchical Hough needs positive fine steps. Returning no lines.");
+    return {};
+  }
+
+  // rho in fine rows has to fit Q16 like in the half-plane accumulator
+  if (std::hypot(size.width, size.height) / options.fine_rho_step >= (1 << (30 - TrigTable::kFractionBits))) {
+    ERROR("The fine rho step is too small for a {} x {} image. Returning no lines.", size.width, size.height);
+    return {};
+  }
+
+  // Coarse pass
+  HalfPlaneOptions coarse;
+  coarse.theta_count = options.coarse_theta_count;
+  coarse.rho_step = options.coarse_rho_step;
+  coarse.threads = options.threads;
+  HalfPlaneAccumulator acc = vote_half_plane(points, size, coarse);
+  if (acc.votes.empty()) {
+    return {};
+  }
+
+  const int half = options.window / 2;
+  if (half >= acc.votes.cols) {
+    ERROR("The peak window is wider than the coarse theta range. Returning no lines.");
+    return {};
+  }
+
+  const int candidates = options.candidates > 0 ? options.candidates : 2 * k;
+  std::vector<HoughPeak> peaks = find_peaks(wrap_theta(acc.votes, half), options.window, candidates,
+                                            options.min_votes);
+
+  // Fine pass, one patch per coarse peak
+  const int theta_count = (int)std::ceil(2 * acc.theta_step / options.fine_theta_step) + 1;
+  const int rho_count = (int)std::ceil(2 * acc.rho_step / options.fine_rho_step) + 1;
+  std::vector<HoughLine> refined(peaks.size());
+
+  int workers = options.threads > 0 ? options.threads : cv::getNumThreads();
+  workers = std::max(1, std::min(workers, (int)peaks.size()));
+
+  cv::parallel_for_(cv::Range(0, (int)peaks.size()), [&](const cv::Range &range) {
+    for (int i = range.start; i < range.end; i++) {
+      Patch patch = { acc.theta(peaks[i].theta - half) - acc.theta_step, acc.rho(peaks[i].rho) - acc.rho_step,
+                      theta_count, rho_count };
+      refined[i] = climb(points, patch, options);
+    }
+  }, workers);
+
+  std::stable_sort(refined.begin(), refined.end(),
+                   [](const HoughLine &a, const HoughLine &b) { return a.votes > b.votes; });
+
+  // Two coarse peaks can climb to the same line, and a digital line leaves
+  // a ridge of weaker maxima next to its own at fine resolution
+  std::vector<HoughLine> lines;
+  for (const HoughLine &line : refined) {
+    if (line.votes < std::max(1, options.min_votes)) {
+      break;
+    }
+
+    bool duplicate = std::any_of(lines.begin(), lines.end(), [&](const HoughLine &kept) {
+      double dtheta = std::abs(kept.theta - line.theta);
+      double drho = std::abs(kept.rho - line.rho);
+      // The same line near the ends of the theta range
+      if (dtheta > CV_PI / 2) {
+        dtheta = CV_PI - dtheta;
+        drho = std::abs(kept.rho + line.rho);
+      }
+      return dtheta <= 2 * acc.theta_step && drho <= 2 * acc.rho_step;
+    });
+
+    if (!duplicate) {
+      lines.push_back(line);
+      if ((int)lines.size() >= k) {
+        break;
+      }
+    }
+  }
+
+  return lines;
+}
@@ -0,0 +1,39 @@
+#ifndef __HOUGH_HIERARCHICAL_H__
+#define __HOUGH_HIERARCHICAL_H__
+
+#include "opencv2/opencv.hpp"
+#include "../common/points/point_extractor.h"
+#include "line_segment.h"
+#include <vector>
+
+struct HierarchicalOptions {
+  // Coarse grid over theta in [0, pi) and signed rho
+  int coarse_theta_count = 90; // 2 degrees
+  double coarse_rho_step = 4.0;
+  int window = 3;     // peak suppression window on the coarse grid
+  int candidates = 0; // coarse peaks to refine, 0 for twice the lines wanted
+  int min_votes = 1;
+  // Resolution of the patches around the coarse peaks
+  double fine_theta_step = 0.1 * CV_PI / 180;
+  double fine_rho_step = 0.5;
+  int threads = 0; // 0 uses cv::getNumThreads()
+};
+
+// The k strongest lines through the points of an image of the given size,
+// coarse to fine. The points vote into a coarse half-plane accumulator, and
+// each of its strongest peaks is refined in a fine accumulator patch that
+// spans one coarse cell on every side of it, voted by only the points whose
+// rho comes within that patch. Memory and time beyond the coarse pass grow
+// with the number of candidates, not with the fine resolution over the whole
+// plane.
+//
+// A patch whose maximum lies on its border moves on to center there, as the
+// coarse peak was only a slope of the line; coarse cells much longer in
+// theta than in rho, relative to the image size, make that more common.
+// Coarse peaks next to theta = 0 and theta = pi are found too, the grid
+// wrapping around to (theta + pi, -rho). Refined lines within two coarse
+// cells of a stronger one are dropped. Strongest first.
+std::vector<HoughLine> hierarchical_hough(const PointCoordinates<int> &points, cv::Size size, int k,
+                                          const HierarchicalOptions &options = {});
+
+#endif // __HOUGH_HIERARCHICAL_H__
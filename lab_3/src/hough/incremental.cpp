@@ -0,0 +1,80 @@
+#include "incremental.h"
+#include "../common/logger/logger.h"
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+IncrementalHough::IncrementalHough(cv::Size size, const HalfPlaneOptions &options)
+  :acc(vote_half_plane(PointCoordinates<int>(), size, options)), threads(options.threads)
+{
+  if (acc.votes.empty()) {
+    return;
+  }
+
+  // The pixels of a cell lie in a band rho_step wide, which crosses every
+  // column or every row of the frame at most rho_step sqrt(2) + 1 times
+  const double most = (acc.rho_step * std::sqrt(2.0) + 1) * std::max(size.width, size.height);
+  if (std::min(most, (double)size.area()) > UINT16_MAX) {
+    acc.votes = cv::Mat::zeros(acc.votes.rows, acc.votes.cols, CV_32SC1);
+  }
+
+  previous = cv::Mat::zeros(size.height, size.width, CV_8UC1);
+}
+
+std::size_t IncrementalHough::update(const cv::Mat &edges)
+{
+  if (previous.empty()) {
+    ERROR("The incremental Hough accumulator could not be made. Ignoring the frame.");
+    return 0;
+  }
+  if (edges.type() != CV_8UC1 || edges.size() != previous.size()) {
+    ERROR("The incremental Hough transform needs {} x {} CV_8UC1 edge maps. Ignoring the frame.", previous.cols,
+          previous.rows);
+    return 0;
+  }
+
+  // One pass marks the changes of a row and keeps this frame for the next
+  // one; only rows with a change are scanned again for their pixels
+  PointCoordinates<int> added, removed;
+  std::vector<uchar> changes(previous.cols);
+
+  for (int r = 0; r < previous.rows; r++) {
+    const uchar *now = edges.ptr<uchar>(r);
+    uchar *before = previous.ptr<uchar>(r);
+    uchar any = 0;
+
+#pragma omp simd reduction(| : any)
+    for (int c = 0; c < previous.cols; c++) {
+      uchar edge = now[c] != 0;
+      changes[c] = edge ^ before[c];
+      any |= changes[c];
+      before[c] = edge;
+    }
+
+    if (!any) {
+      continue;
+    }
+    for (int c = 0; c < previous.cols; c++) {
+      if (changes[c]) {
+        PointCoordinates<int> &list = now[c] ? added : removed;
+        list.x.push_back(c);
+        list.y.push_back(r);
+      }
+    }
+  }
+
+  // Removing first keeps every cell within the count of one frame
+  update_half_plane(acc, removed, -1, threads);
+  update_half_plane(acc, added, 1, threads);
+
+  return added.size() + removed.size();
+}
+
+void IncrementalHough::reset()
+{
+  if (!previous.empty()) {
+    acc.votes.setTo(0);
+    previous.setTo(0);
+  }
+}
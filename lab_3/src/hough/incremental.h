@@ -0,0 +1,34 @@
+#ifndef __HOUGH_INCREMENTAL_H__
+#define __HOUGH_INCREMENTAL_H__
+
+#include "opencv2/opencv.hpp"
+#include "half_plane.h"
+
+// Half-plane line accumulator kept across the frames of a video. Each frame
+// only the edge pixels that changed since the last one vote: the pixels set
+// in the XOR of the two edge maps add their votes if they are edges now and
+// take them back if they were edges before. For a mostly static scene the
+// voting costs in proportion to the changed pixels, while the accumulator
+// always holds the votes of the current frame alone.
+class IncrementalHough {
+  HalfPlaneAccumulator acc;
+  cv::Mat previous; // 1 where the last frame had an edge
+  int threads;
+
+public:
+  // For frames of the given size. The rho step and angle count come from
+  // the options; the cells are 16-bit as long as no line can gather more
+  // than 65535 pixels of a frame, 32-bit otherwise.
+  IncrementalHough(cv::Size size, const HalfPlaneOptions &options = {});
+
+  // Moves the accumulator on to the nonzero pixels of a CV_8UC1 edge map of
+  // the size given, and returns the number of pixels that changed
+  std::size_t update(const cv::Mat &edges);
+
+  // Back to an empty frame
+  void reset();
+
+  const HalfPlaneAccumulator &accumulator() const { return acc; }
+};
+
+#endif // __HOUGH_INCREMENTAL_H__
@@ -0,0 +1,259 @@
+#include "kernel.h"
+#include "../common/logger/logger.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace {
+
+// Neighbors tried when following a chain, the 4-connected ones first so
+// the chain does not cut corners
+const int kStepX[8] = { 1, 0, -1, 0, 1, -1, -1, 1 };
+const int kStepY[8] = { 0, 1, 0, -1, 1, 1, -1, -1 };
+
+// Follows the unvisited edge pixels from p one neighbor at a time, marking
+// them visited
+void follow(cv::Mat &unvisited, cv::Point p, std::vector<cv::Point> &chain)
+{
+  for (;;) {
+    bool moved = false;
+    for (int k = 0; k < 8; k++) {
+      int x = p.x + kStepX[k], y = p.y + kStepY[k];
+      if (x >= 0 && x < unvisited.cols && y >= 0 && y < unvisited.rows && unvisited.at<uchar>(y, x)) {
+        unvisited.at<uchar>(y, x) = 0;
+        p = cv::Point(x, y);
+        chain.push_back(p);
+        moved = true;
+        break;
+      }
+    }
+    if (!moved) {
+      return;
+    }
+  }
+}
+
+// Principal axis fit of chain[a..b], with the uncertainty of rho and theta
+// propagated from unit noise on the pixels
+EdgeCluster fit(const std::vector<cv::Point> &chain, int a, int b, double theta_floor, double rho_floor)
+{
+  const int n = b - a + 1;
+  double mx = 0, my = 0;
+  for (int i = a; i <= b; i++) {
+    mx += chain[i].x;
+    my += chain[i].y;
+  }
+  mx /= n;
+  my /= n;
+
+  double sxx = 0, syy = 0, sxy = 0;
+  for (int i = a; i <= b; i++) {
+    double dx = chain[i].x - mx, dy = chain[i].y - my;
+    sxx += dx * dx;
+    syy += dy * dy;
+    sxy += dx * dy;
+  }
+
+  double theta = 0.5 * std::atan2(2 * sxy, sxx - syy) + CV_PI / 2;
+  if (theta >= CV_PI) {
+    theta -= CV_PI;
+  }
+  const double c = std::cos(theta), s = std::sin(theta);
+
+  // Spread along the line, which sets how well its angle is known
+  double along = 0;
+  for (int i = a; i <= b; i++) {
+    double u = -(chain[i].x - mx) * s + (chain[i].y - my) * c;
+    along += u * u;
+  }
+
+  EdgeCluster cluster;
+  cluster.first = chain[a];
+  cluster.last = chain[b];
+  cluster.pixels = n;
+  cluster.theta = theta;
+  cluster.rho = mx * c + my * s;
+
+  // Through the centroid rho and theta are independent; d rho / d theta at
+  // the origin is the position of the centroid along the line
+  const double theta_variance = std::max(along > 0 ? 1.0 / along : 1.0, theta_floor * theta_floor);
+  const double centroid_variance = std::max(1.0 / n, rho_floor * rho_floor);
+  const double m = -mx * s + my * c;
+  cluster.theta_variance = theta_variance;
+  cluster.rho_variance = centroid_variance + m * m * theta_variance;
+  cluster.covariance = m * theta_variance;
+  return cluster;
+}
+
+// Splits chain into clusters no pixel of which deviates more than
+// max_deviation from the segment between its ends
+void subdivide(const std::vector<cv::Point> &chain, const KernelOptions &options, double theta_floor,
+               double rho_floor, std::vector<EdgeCluster> &clusters)
+{
+  std::vector<std::pair<int, int>> pending = { { 0, (int)chain.size() - 1 } };
+
+  while (!pending.empty()) {
+    auto [a, b] = pending.back();
+    pending.pop_back();
+    if (b - a + 1 < options.min_cluster) {
+      continue;
+    }
+
+    // Distance from the line through the ends, or from the first end when a
+    // chain closes on itself
+    const double ex = chain[b].x - chain[a].x, ey = chain[b].y - chain[a].y;
+    const double length = std::hypot(ex, ey);
+    double farthest = 0;
+    int split = a;
+    for (int i = a + 1; i < b; i++) {
+      double px = chain[i].x - chain[a].x, py = chain[i].y - chain[a].y;
+      double d = length > 0 ? std::abs(px * ey - py * ex) / length : std::hypot(px, py);
+      if (d > farthest) {
+        farthest = d;
+        split = i;
+      }
+    }
+
+    if (farthest > options.max_deviation) {
+      pending.push_back({ split, b });
+      pending.push_back({ a, split });
+    }
+    else {
+      clusters.push_back(fit(chain, a, b, theta_floor, rho_floor));
+    }
+  }
+}
+
+// Votes of one cluster for the angles [t0, t1)
+void vote_kernel(const EdgeCluster &cluster, HalfPlaneAccumulator &acc, double extent, int t0, int t1)
+{
+  const int count = acc.votes.cols;
+  const double theta_sd = std::sqrt(cluster.theta_variance);
+  // Given theta, rho varies only as through the centroid
+  const double slope = cluster.covariance / cluster.theta_variance;
+  const double rho_sd = std::sqrt(std::max(0.0, cluster.rho_variance - slope * cluster.covariance));
+  const double theta_reach = std::min(extent * theta_sd, CV_PI / 2);
+  const double rho_reach = extent * rho_sd;
+
+  const int first = (int)std::ceil((cluster.theta - theta_reach) / acc.theta_step);
+  const int last = (int)std::floor((cluster.theta + theta_reach) / acc.theta_step);
+
+  for (int t = first; t <= last; t++) {
+    // Angles past either end of the half turn are (theta -/+ pi, -rho)
+    const int column = (t % count + count) % count;
+    if (column < t0 || column >= t1) {
+      continue;
+    }
+    const int sign = t < 0 || t >= count ? -1 : 1;
+
+    const double dtheta = t * acc.theta_step - cluster.theta;
+    const double center = cluster.rho + slope * dtheta;
+    const double angular = dtheta * dtheta / cluster.theta_variance;
+
+    const int r0 = (int)std::ceil((center - rho_reach) / acc.rho_step);
+    const int r1 = (int)std::floor((center + rho_reach) / acc.rho_step);
+    for (int r = r0; r <= r1; r++) {
+      const int row = sign * r + acc.rho_offset;
+      if (row < 0 || row >= acc.votes.rows) {
+        continue;
+      }
+
+      const double offset = r * acc.rho_step - center;
+      const double d2 = angular + (rho_sd > 0 ? offset * offset / (rho_sd * rho_sd) : 0);
+      if (d2 <= extent * extent) {
+        acc.votes.ptr<int32_t>(row)[column] += (int32_t)std::lround(cluster.pixels * std::exp(-0.5 * d2));
+      }
+    }
+  }
+}
+
+} // namespace
+
+std::vector<EdgeCluster> edge_clusters(const PointCoordinates<int> &points, cv::Size size,
+                                       const KernelOptions &options)
+{
+  std::vector<EdgeCluster> clusters;
+
+  if (options.theta_count <= 0 || !(options.rho_step > 0) || size.width <= 0 || size.height <= 0) {
+    ERROR("Kernel voting needs a positive image size, angle count and rho step. Returning no clusters.");
+    return clusters;
+  }
+
+  cv::Mat unvisited = cv::Mat::zeros(size.height, size.width, CV_8UC1);
+  for (std::size_t i = 0; i < points.size(); i++) {
+    if (points.x[i] < 0 || points.x[i] >= size.width || points.y[i] < 0 || points.y[i] >= size.height) {
+      ERROR("Point ({}, {}) is outside the {} x {} image. Returning no clusters.", points.x[i], points.y[i],
+            size.width, size.height);
+      return clusters;
+    }
+    unvisited.at<uchar>(points.y[i], points.x[i]) = 1;
+  }
+
+  // The kernel covers at least the cell it falls in
+  const double theta_floor = CV_PI / options.theta_count / 2;
+  const double rho_floor = options.rho_step / 2;
+
+  std::vector<cv::Point> forward, backward;
+  for (std::size_t i = 0; i < points.size(); i++) {
+    cv::Point seed(points.x[i], points.y[i]);
+    if (!unvisited.at<uchar>(seed.y, seed.x)) {
+      continue;
+    }
+    unvisited.at<uchar>(seed.y, seed.x) = 0;
+
+    // Both ways from the seed, joined end to end
+    forward.clear();
+    backward.clear();
+    follow(unvisited, seed, forward);
+    follow(unvisited, seed, backward);
+
+    std::reverse(backward.begin(), backward.end());
+    backward.push_back(seed);
+    backward.insert(backward.end(), forward.begin(), forward.end());
+
+    if ((int)backward.size() >= options.min_cluster) {
+      subdivide(backward, options, theta_floor, rho_floor, clusters);
+    }
+  }
+
+  return clusters;
+}
+
+HalfPlaneAccumulator vote_kernels(const std::vector<EdgeCluster> &clusters, cv::Size size,
+                                  const KernelOptions &options)
+{
+  HalfPlaneAccumulator acc;
+
+  if (options.theta_count <= 0 || !(options.rho_step > 0) || size.width <= 0 || size.height <= 0) {
+    ERROR("Kernel voting needs a positive image size, angle count and rho step. Returning an empty accumulator.");
+    return acc;
+  }
+
+  acc.size = size;
+  acc.rho_offset = (int)std::ceil(std::hypot(size.width, size.height) / options.rho_step) + 1;
+  acc.rho_step = options.rho_step;
+  acc.theta_step = CV_PI / options.theta_count;
+  acc.votes = cv::Mat::zeros(2 * acc.rho_offset + 1, options.theta_count, CV_32SC1);
+
+  // Whole cache lines of cells per worker
+  const int count = options.theta_count;
+  const int lanes = 64 / sizeof(int32_t);
+  int workers = options.threads > 0 ? options.threads : cv::getNumThreads();
+  workers = std::max(1, std::min(workers, (count + lanes - 1) / lanes));
+  const int chunk = ((count + workers - 1) / workers + lanes - 1) / lanes * lanes;
+
+  cv::parallel_for_(cv::Range(0, workers), [&](const cv::Range &range) {
+    for (int w = range.start; w < range.end; w++) {
+      int t0 = std::min(count, w * chunk);
+      int t1 = std::min(count, t0 + chunk);
+      for (const EdgeCluster &cluster : clusters) {
+        if (t0 < t1) {
+          vote_kernel(cluster, acc, options.kernel_extent, t0, t1);
+        }
+      }
+    }
+  }, workers);
+
+  return acc;
+}
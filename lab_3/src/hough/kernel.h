@@ -0,0 +1,51 @@
+#ifndef __HOUGH_KERNEL_H__
+#define __HOUGH_KERNEL_H__
+
+#include "opencv2/opencv.hpp"
+#include "../common/points/point_extractor.h"
+#include "half_plane.h"
+#include <vector>
+
+struct KernelOptions {
+  int theta_count = 180; // angles over [0, pi)
+  double rho_step = 1.0; // pixels per rho row
+  int min_cluster = 10;  // pixels; shorter chains and clusters do not vote
+  // A cluster is split at its pixel farthest from the line through its
+  // ends while that pixel is farther than this, in pixels
+  double max_deviation = 1.0;
+  double kernel_extent = 2.0; // standard deviations the kernel reaches out
+  int threads = 0;            // 0 uses cv::getNumThreads()
+};
+
+// A run of approximately collinear edge pixels, fitted with a line
+struct EdgeCluster {
+  cv::Point first, last; // end pixels along the chain
+  int pixels;
+  double rho;   // signed, in pixels
+  double theta; // in [0, pi) radians
+  // Uncertainty of the fit, from unit pixel noise
+  double rho_variance;
+  double theta_variance;
+  double covariance;
+};
+
+// Approximately collinear clusters of the edge points of an image of the
+// given size. The points are linked into 8-connected chains, and each chain
+// is split recursively at the pixel farthest from the segment between its
+// ends, until none is farther than options.max_deviation. Each cluster is
+// fitted once, by the principal axis of its pixels.
+std::vector<EdgeCluster> edge_clusters(const PointCoordinates<int> &points, cv::Size size,
+                                       const KernelOptions &options = {});
+
+// Kernel-based Hough transform (Fernandes and Oliveira): each cluster casts
+// one elliptical Gaussian vote, shaped by the uncertainty of its fit, into a
+// 32-bit half-plane accumulator laid out as vote_half_plane lays it out. A
+// cell within options.kernel_extent standard deviations of the fit gets
+// round(pixels exp(-d^2 / 2)) votes, d its Mahalanobis distance, so a
+// cluster peaks at its pixel count as in pixel voting. The cost is the
+// kernel footprint per cluster, not the angle count per pixel. The angles
+// are split between threads as in vote_half_plane.
+HalfPlaneAccumulator vote_kernels(const std::vector<EdgeCluster> &clusters, cv::Size size,
+                                  const KernelOptions &options = {});
+
+#endif // __HOUGH_KERNEL_H__
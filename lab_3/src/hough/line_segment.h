@@ -0,0 +1,19 @@
+#ifndef __HOUGH_LINE_SEGMENT_H__
+#define __HOUGH_LINE_SEGMENT_H__
+
+#include "opencv2/opencv.hpp"
+
+// A detected line segment between two edge pixels, both included
+struct LineSegment {
+  cv::Point start;
+  cv::Point end;
+};
+
+// A detected line x cos(theta) + y sin(theta) = rho
+struct HoughLine {
+  double rho;   // signed, in pixels
+  double theta; // in [0, pi) radians
+  int votes;
+};
+
+#endif // __HOUGH_LINE_SEGMENT_H__
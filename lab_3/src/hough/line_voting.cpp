@@ -0,0 +1,239 @@
+#include "line_voting.h"
+#include "../common/logger/logger.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace {
+
+// Accumulator of rho_max + 2 rows, the last one catching out-of-range votes
+struct VoteTarget {
+  int32_t *acc;
+  int32_t step; // in cells
+  uint32_t rho_max;
+};
+
+// The points, and for oriented voting their gradient directions and the
+// half-width of the angle window around them, in table steps
+struct VoteInput {
+  const int *xs;
+  const int *ys;
+  const float *orientations = nullptr;
+  int half_window = 0;
+};
+
+// Votes of point (x, y) for angles [t0, t1)
+__attribute__((always_inline)) inline void vote_point(int32_t x, int32_t y, int t0, int t1, const TrigTable &table,
+                                                      const VoteTarget &target, int32_t *offsets)
+{
+  const int32_t *cosq = table.cos_q();
+  const int32_t *sinq = table.sin_q();
+  const uint32_t spill = target.rho_max + 1;
+  const int32_t step = target.step;
+
+  // Negative rho wraps around to a large unsigned value and spills too
+#pragma omp simd
+  for (int t = t0; t < t1; t++) {
+    uint32_t rho = (uint32_t)((x * cosq[t] + y * sinq[t] + TrigTable::kHalf) >> TrigTable::kFractionBits);
+    offsets[t - t0] = (int32_t)std::min(rho, spill) * step + t;
+  }
+
+  for (int t = 0; t < t1 - t0; t++) {
+    target.acc[offsets[t]]++;
+  }
+}
+
+// Parts of [t0, t1) within half_window steps of the gradient direction of
+// the point or of its opposite, at most four ranges. The windows wrap
+// around the full turn the table covers.
+inline int window_ranges(float orientation, const TrigTable &table, int half_window, int t0, int t1, int *ranges)
+{
+  const int count = table.size();
+  if (std::isnan(orientation) || 4 * half_window + 2 >= count) {
+    ranges[0] = t0;
+    ranges[1] = t1;
+    return 1;
+  }
+
+  const int center = (int)std::lround((orientation - table.angle(0)) / table.angle_step());
+  const int opposite = center + count / 2;
+  int parts = 0;
+
+  for (int c : { center, opposite }) {
+    int lo = ((c - half_window) % count + count) % count;
+    int hi = lo + 2 * half_window + 1;
+
+    // [lo, hi) and its part past the end of the table, moved to the front
+    int pieces[2][2] = { { lo, std::min(hi, count) }, { 0, hi - count } };
+    for (const int *piece : pieces) {
+      int a = std::max(piece[0], t0);
+      int b = std::min(piece[1], t1);
+      if (a < b) {
+        ranges[2 * parts] = a;
+        ranges[2 * parts + 1] = b;
+        parts++;
+      }
+    }
+  }
+  return parts;
+}
+
+// Votes of points [from, to) for the angles of [t0, t1) they vote for
+__attribute__((always_inline)) inline void vote_points(const VoteInput &input, std::size_t from, std::size_t to,
+                                                       const TrigTable &table, int t0, int t1,
+                                                       const VoteTarget &target, int32_t *offsets)
+{
+  if (input.orientations == nullptr) {
+    for (std::size_t i = from; i < to; i++) {
+      vote_point(input.xs[i], input.ys[i], t0, t1, table, target, offsets);
+    }
+    return;
+  }
+
+  int ranges[8];
+  for (std::size_t i = from; i < to; i++) {
+    int parts = window_ranges(input.orientations[i], table, input.half_window, t0, t1, ranges);
+    for (int k = 0; k < parts; k++) {
+      vote_point(input.xs[i], input.ys[i], ranges[2 * k], ranges[2 * k + 1], table, target, offsets);
+    }
+  }
+}
+
+void vote_points_default(const VoteInput &input, std::size_t from, std::size_t to, const TrigTable &table,
+                         int t0, int t1, const VoteTarget &target, int32_t *offsets)
+{
+  vote_points(input, from, to, table, t0, t1, target, offsets);
+}
+
+__attribute__((target("avx2")))
+void vote_points_avx2(const VoteInput &input, std::size_t from, std::size_t to, const TrigTable &table,
+                      int t0, int t1, const VoteTarget &target, int32_t *offsets)
+{
+  vote_points(input, from, to, table, t0, t1, target, offsets);
+}
+
+bool has_avx2()
+{
+  static const bool avx2 = [] {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+  }();
+  return avx2;
+}
+
+void vote_range(const VoteInput &input, std::size_t from, std::size_t to, const TrigTable &table,
+                int t0, int t1, const VoteTarget &target)
+{
+  std::vector<int32_t> offsets(t1 - t0);
+
+  if (has_avx2()) {
+    vote_points_avx2(input, from, to, table, t0, t1, target, offsets.data());
+  }
+  else {
+    vote_points_default(input, from, to, table, t0, t1, target, offsets.data());
+  }
+}
+
+void vote_private(const VoteInput &input, std::size_t n, const TrigTable &table, int workers, cv::Mat &votes)
+{
+  const int rows = votes.rows - 1;
+
+  // Worker 0 votes straight into the result
+  std::vector<cv::Mat> partial(workers);
+  partial[0] = votes;
+
+  cv::parallel_for_(cv::Range(0, workers), [&](const cv::Range &range) {
+    for (int w = range.start; w < range.end; w++) {
+      if (w > 0) {
+        partial[w] = cv::Mat::zeros(votes.rows, votes.cols, CV_32SC1);
+      }
+      VoteTarget target = { partial[w].ptr<int32_t>(0), (int32_t)(partial[w].step / sizeof(int32_t)),
+                            (uint32_t)(rows - 1) };
+      vote_range(input, n * w / workers, n * (w + 1) / workers, table, 0, table.size(), target);
+    }
+  }, workers);
+
+  cv::parallel_for_(cv::Range(0, workers), [&](const cv::Range &range) {
+    for (int w = range.start; w < range.end; w++) {
+      for (int r = rows * w / workers; r < rows * (w + 1) / workers; r++) {
+        int32_t *sum = votes.ptr<int32_t>(r);
+        for (int k = 1; k < workers; k++) {
+          const int32_t *part = partial[k].ptr<int32_t>(r);
+          for (int t = 0; t < votes.cols; t++) {
+            sum[t] += part[t];
+          }
+        }
+      }
+    }
+  }, workers);
+}
+
+void vote_theta_partition(const VoteInput &input, std::size_t n, const TrigTable &table, int workers, cv::Mat &votes)
+{
+  const int count = table.size();
+  VoteTarget target = { votes.ptr<int32_t>(0), (int32_t)(votes.step / sizeof(int32_t)), (uint32_t)(votes.rows - 2) };
+
+  // Whole vectors of angles per worker, so only the last one has a tail
+  const int lanes = 8;
+  const int chunk = ((count + workers - 1) / workers + lanes - 1) / lanes * lanes;
+
+  cv::parallel_for_(cv::Range(0, workers), [&](const cv::Range &range) {
+    for (int w = range.start; w < range.end; w++) {
+      int t0 = std::min(count, w * chunk);
+      int t1 = std::min(count, t0 + chunk);
+      if (t0 < t1) {
+        vote_range(input, 0, n, table, t0, t1, target);
+      }
+    }
+  }, workers);
+}
+
+cv::Mat vote(const VoteInput &input, std::size_t n, const TrigTable &table, int rho_count,
+             const LineVotingOptions &options)
+{
+  if (rho_count <= 0 || rho_count >= (1 << (31 - TrigTable::kFractionBits))) {
+    ERROR("Line voting needs between 1 and 32767 rho values. Returning an empty accumulator.");
+    return cv::Mat();
+  }
+
+  cv::Mat votes = cv::Mat::zeros(rho_count + 1, table.size(), CV_32SC1);
+
+  int workers = options.threads > 0 ? options.threads : cv::getNumThreads();
+  workers = std::max(1, std::min<int>(workers, (int)std::min<std::size_t>(n, 256)));
+
+  if (workers == 1) {
+    VoteTarget target = { votes.ptr<int32_t>(0), (int32_t)(votes.step / sizeof(int32_t)), (uint32_t)(rho_count - 1) };
+    vote_range(input, 0, n, table, 0, table.size(), target);
+  }
+  else if (options.strategy == VoteStrategy::PRIVATE_ACCUMULATORS) {
+    vote_private(input, n, table, workers, votes);
+  }
+  else {
+    vote_theta_partition(input, n, table, workers, votes);
+  }
+
+  return votes(cv::Range(0, rho_count), cv::Range::all());
+}
+
+} // namespace
+
+cv::Mat vote_lines(const PointCoordinates<int> &points, const TrigTable &table, int rho_count,
+                   const LineVotingOptions &options)
+{
+  VoteInput input = { points.x.data(), points.y.data() };
+  return vote(input, points.size(), table, rho_count, options);
+}
+
+cv::Mat vote_lines(const PointCoordinates<int> &points, const std::vector<float> &orientations,
+                   const TrigTable &table, int rho_count, const LineVotingOptions &options)
+{
+  if (orientations.size() != points.size()) {
+    ERROR("Oriented line voting needs one orientation per point. Returning an empty accumulator.");
+    return cv::Mat();
+  }
+
+  VoteInput input = { points.x.data(), points.y.data(), orientations.data(),
+                      (int)std::floor(options.angle_window / table.angle_step()) };
+  return vote(input, points.size(), table, rho_count, options);
+}
@@ -0,0 +1,52 @@
+#ifndef __HOUGH_LINE_VOTING_H__
+#define __HOUGH_LINE_VOTING_H__
+
+#include "opencv2/opencv.hpp"
+#include "../common/points/point_extractor.h"
+#include "trig_table.h"
+
+// How vote_lines spreads the work over threads
+enum class VoteStrategy {
+  // Each worker votes a band of the points into an accumulator of its own,
+  // then every worker sums one band of rho rows over all of them. Costs an
+  // accumulator per worker and a pass over them, but the points are read
+  // once; wins when there are many points for a small accumulator.
+  PRIVATE_ACCUMULATORS,
+  // Each worker votes every point, but only for its range of angles of the
+  // shared accumulator, so no copy and no reduction is needed. The points
+  // are read once per worker; wins for large accumulators.
+  THETA_PARTITION,
+};
+
+struct LineVotingOptions {
+  VoteStrategy strategy = VoteStrategy::THETA_PARTITION;
+  int threads = 0; // 0 uses cv::getNumThreads()
+  // With orientations, how far from its gradient direction a point still
+  // votes, in radians
+  double angle_window = 5 * CV_PI / 180;
+};
+
+// Votes of the points for the lines through them. Cell (rho, t) of the
+// returned CV_32SC1 rho_count x table.size() accumulator counts the points
+// with round(x cos + y sin) == rho for angle t of the table; rho outside
+// [0, rho_count) is dropped, like in the lab. Both strategies give the same
+// accumulator for any thread count.
+//
+// Per point, the rho of all angles come from the fixed-point tables in one
+// vectorized pass and the increments then go through raw row offsets. Votes
+// that fall outside the accumulator land in a spill row instead of being
+// branched around.
+cv::Mat vote_lines(const PointCoordinates<int> &points, const TrigTable &table, int rho_count,
+                   const LineVotingOptions &options = {});
+
+// vote_lines where point i only votes for the angles within
+// options.angle_window of orientations[i], its gradient direction, and of the
+// opposite direction: the normal of a line through an edge point follows the
+// gradient there. A 5 degree window casts 22 of 360 votes per point and
+// leaves peaks sharper, as points no longer vote for lines across their
+// edge. Points with a NaN orientation vote for every angle. The table must
+// cover the full turn.
+cv::Mat vote_lines(const PointCoordinates<int> &points, const std::vector<float> &orientations,
+                   const TrigTable &table, int rho_count, const LineVotingOptions &options = {});
+
+#endif // __HOUGH_LINE_VOTING_H__
@@ -0,0 +1,154 @@
+#include "peaks.h"
+#include "../common/logger/logger.h"
+
+#include <algorithm>
+#include <queue>
+
+namespace {
+
+// out[c] = max(in[c - half .. c + half]) for c in [half, n - half)
+template <typename T>
+void running_max(const T *in, T *out, int n, int half, T *prefix, T *suffix)
+{
+  const int window = 2 * half + 1;
+
+  for (int start = 0; start < n; start += window) {
+    const int end = std::min(n, start + window);
+    prefix[start] = in[start];
+    for (int i = start + 1; i < end; i++) {
+      prefix[i] = std::max(prefix[i - 1], in[i]);
+    }
+    suffix[end - 1] = in[end - 1];
+    for (int i = end - 2; i >= start; i--) {
+      suffix[i] = std::max(suffix[i + 1], in[i]);
+    }
+  }
+
+  for (int c = half; c < n - half; c++) {
+    out[c] = std::max(suffix[c - half], prefix[c + half]);
+  }
+}
+
+// dst[j] = max(a[j], b[j])
+template <typename T>
+inline void max_of(const T *a, const T *b, T *dst, int cols)
+{
+  for (int j = 0; j < cols; j++) {
+    dst[j] = std::max(a[j], b[j]);
+  }
+}
+
+// Heap order: the root is the weakest peak kept, the later one on ties
+struct Weaker {
+  bool operator()(const HoughPeak &a, const HoughPeak &b) const
+  {
+    if (a.votes != b.votes) {
+      return a.votes > b.votes;
+    }
+    return a.rho != b.rho ? a.rho < b.rho : a.theta < b.theta;
+  }
+};
+
+template <typename T>
+std::vector<HoughPeak> find_peaks_of(const cv::Mat &acc, int half, int k, int min_votes)
+{
+  const int window = 2 * half + 1;
+  const int rows = acc.rows;
+  const int cols = acc.cols;
+
+  // The column pass streams over blocks of window rows, so the scratch holds
+  // two blocks of rows instead of whole accumulators: the row maxima of the
+  // current block, the suffix maxima of the previous one, and the prefix
+  // maximum of the current one down to the latest row
+  std::vector<T> block((std::size_t)window * cols), previous((std::size_t)window * cols);
+  std::vector<T> prefix(cols), maxima(cols), row_prefix(cols), row_suffix(cols);
+
+  std::priority_queue<HoughPeak, std::vector<HoughPeak>, Weaker> strongest;
+  const int threshold = std::max(1, min_votes);
+
+  auto scan = [&](int r, const T *dilated) {
+    const T *cells = acc.ptr<T>(r);
+    for (int t = half; t < cols - half; t++) {
+      int votes = cells[t];
+      if (votes < threshold || cells[t] != dilated[t]) {
+        continue;
+      }
+
+      HoughPeak peak = { r, t, votes };
+      if ((int)strongest.size() < k) {
+        strongest.push(peak);
+      }
+      else if (Weaker()(peak, strongest.top())) {
+        strongest.pop();
+        strongest.push(peak);
+      }
+    }
+  };
+
+  for (int start = 0; start < rows; start += window) {
+    const int end = std::min(rows, start + window);
+
+    for (int r = start; r < end; r++) {
+      T *horizontal = &block[(std::size_t)(r - start) * cols];
+      running_max(acc.ptr<T>(r), horizontal, cols, half, row_prefix.data(), row_suffix.data());
+      if (r == start) {
+        std::copy(horizontal, horizontal + cols, prefix.begin());
+      }
+      else {
+        max_of(prefix.data(), horizontal, prefix.data(), cols);
+      }
+
+      // Row c spans rows c - half .. c + half = r: the suffix of the previous
+      // block from c - half on and the prefix of this one, or this whole
+      // block when c - half is its first row
+      const int c = r - half;
+      if (c < half || c >= rows - half) {
+        continue;
+      }
+      const int j = r - start;
+      if (j == window - 1) {
+        scan(c, prefix.data());
+      }
+      else {
+        max_of(&previous[(std::size_t)(j + 1) * cols], prefix.data(), maxima.data(), cols);
+        scan(c, maxima.data());
+      }
+    }
+
+    // Suffix maxima of this block, for the rows of the next one
+    const int last = end - 1 - start;
+    std::copy(&block[(std::size_t)last * cols], &block[(std::size_t)last * cols] + cols,
+              &previous[(std::size_t)last * cols]);
+    for (int i = last - 1; i >= 0; i--) {
+      max_of(&previous[(std::size_t)(i + 1) * cols], &block[(std::size_t)i * cols], &previous[(std::size_t)i * cols],
+             cols);
+    }
+  }
+
+  std::vector<HoughPeak> peaks(strongest.size());
+  for (int i = (int)peaks.size() - 1; i >= 0; i--) {
+    peaks[i] = strongest.top();
+    strongest.pop();
+  }
+  return peaks;
+}
+
+} // namespace
+
+std::vector<HoughPeak> find_peaks(const cv::Mat &acc, int window, int k, int min_votes)
+{
+  const int half = window / 2;
+  if (k <= 0 || acc.rows <= 2 * half || acc.cols <= 2 * half) {
+    return {};
+  }
+
+  switch (acc.type()) {
+    case CV_32SC1:
+      return find_peaks_of<int32_t>(acc, half, k, min_votes);
+    case CV_16UC1:
+      return find_peaks_of<uint16_t>(acc, half, k, min_votes);
+  }
+
+  ERROR("Peak detection needs a CV_32SC1 or CV_16UC1 accumulator. Returning no peaks.");
+  return {};
+}
@@ -0,0 +1,28 @@
+#ifndef __HOUGH_PEAKS_H__
+#define __HOUGH_PEAKS_H__
+
+#include "opencv2/opencv.hpp"
+#include <vector>
+
+struct HoughPeak {
+  int rho;   // accumulator row
+  int theta; // accumulator column
+  int votes;
+};
+
+// The k strongest local maxima of a CV_32SC1 or CV_16UC1 accumulator: cells
+// with at least min_votes votes that no cell of the window x window
+// neighborhood around them exceeds, away from the border by half a window.
+// Strongest first, ties in row-major order.
+//
+// The neighborhood maximum is a separable running-max dilation (van Herk /
+// Gil-Werman): per row and then per column, a prefix and a suffix maximum
+// over blocks of window cells give the maximum of any window from two
+// lookups, so the cost per cell does not depend on the window size. The
+// column pass runs on whole rows at a time and streams over blocks of window
+// rows, so the scratch is a few rows, not accumulator-sized, and each row is
+// scanned as soon as its maxima are known. Only k candidates are kept, in a
+// bounded min-heap.
+std::vector<HoughPeak> find_peaks(const cv::Mat &acc, int window, int k, int min_votes = 1);
+
+#endif // __HOUGH_PEAKS_H__
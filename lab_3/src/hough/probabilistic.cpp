@@ -0,0 +1,165 @@
+#include "probabilistic.h"
+#include "../common/logger/logger.h"
+#include "../common/points/point_extractor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+
+namespace {
+
+// States of the pixels of the edge image
+enum : uchar {
+  kEmpty = 0,   // no edge, or removed with a segment
+  kPending = 1, // edge that has not voted yet
+  kVoted = 2,
+};
+
+constexpr int kShift = 16;
+
+// Fixed-point DDA along a line direction: one pixel per step along the
+// major axis, the minor coordinate in Q16
+class LineWalker {
+  bool x_major;
+  int x0, y0;
+  int dx, dy;
+
+public:
+  LineWalker(int x, int y, double a, double b)
+  {
+    x_major = std::abs(a) > std::abs(b);
+    if (x_major) {
+      dx = a > 0 ? 1 : -1;
+      dy = (int)std::lround(b * (1 << kShift) / std::abs(a));
+      x0 = x;
+      y0 = (y << kShift) + (1 << (kShift - 1));
+    }
+    else {
+      dy = b > 0 ? 1 : -1;
+      dx = (int)std::lround(a * (1 << kShift) / std::abs(b));
+      x0 = (x << kShift) + (1 << (kShift - 1));
+      y0 = y;
+    }
+  }
+
+  // Calls step(point) for the pixels from the start in direction sign (1
+  // or -1) until it returns false or the walk leaves the image
+  template <typename F>
+  void walk(int sign, int width, int height, F step) const
+  {
+    for (int px = x0, py = y0;; px += sign * dx, py += sign * dy) {
+      cv::Point p = x_major ? cv::Point(px, py >> kShift) : cv::Point(px >> kShift, py);
+      if (p.x < 0 || p.x >= width || p.y < 0 || p.y >= height || !step(p)) {
+        break;
+      }
+    }
+  }
+};
+
+} // namespace
+
+std::vector<LineSegment> probabilistic_hough(const cv::Mat &edges, const TrigTable &table,
+                                             const ProbabilisticOptions &options)
+{
+  std::vector<LineSegment> segments;
+
+  if (edges.type() != CV_8UC1) {
+    ERROR("The probabilistic Hough transform needs an 8-bit single-channel edge image. Returning no segments.");
+    return segments;
+  }
+
+  const int width = edges.cols;
+  const int height = edges.rows;
+  const int count = table.size();
+  const int32_t *cosq = table.cos_q();
+  const int32_t *sinq = table.sin_q();
+
+  // Signed rho in [-diagonal, diagonal], stored shifted by diagonal, one
+  // accumulator row per angle
+  const int diagonal = (int)std::ceil(std::hypot(width, height));
+  const int rho_count = 2 * diagonal + 1;
+  std::vector<int32_t> acc((std::size_t)count * rho_count, 0);
+
+  auto cell = [&](int x, int y, int t) -> int32_t & {
+    int rho = (x * cosq[t] + y * sinq[t] + TrigTable::kHalf) >> TrigTable::kFractionBits;
+    return acc[(std::size_t)t * rho_count + rho + diagonal];
+  };
+
+  PointCoordinates<int> points = extractPoints<int>(edges, PixelPredicate::notEqual(0));
+  std::vector<uchar> state((std::size_t)width * height, kEmpty);
+  for (std::size_t i = 0; i < points.size(); i++) {
+    state[(std::size_t)points.y[i] * width + points.x[i]] = kPending;
+  }
+
+  std::vector<uint32_t> order(points.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::shuffle(order.begin(), order.end(), std::mt19937_64(options.seed));
+
+  for (uint32_t index : order) {
+    const int x = points.x[index];
+    const int y = points.y[index];
+    uchar &self = state[(std::size_t)y * width + x];
+
+    // Removed with the segment of an earlier pixel
+    if (self != kPending) {
+      continue;
+    }
+
+    // Vote, keeping the strongest line through the pixel
+    int best_votes = 0, best_t = 0;
+    for (int t = 0; t < count; t++) {
+      int votes = ++cell(x, y, t);
+      if (votes > best_votes) {
+        best_votes = votes;
+        best_t = t;
+      }
+    }
+    self = kVoted;
+
+    if (best_votes < options.threshold) {
+      continue;
+    }
+
+    // The line runs along (-sin, cos), perpendicular to its normal
+    LineWalker walker(x, y, -table.sin(best_t), table.cos(best_t));
+    cv::Point ends[2] = { cv::Point(x, y), cv::Point(x, y) };
+
+    for (int k = 0; k < 2; k++) {
+      int gap = 0;
+      walker.walk(k == 0 ? 1 : -1, width, height, [&](cv::Point p) {
+        if (state[(std::size_t)p.y * width + p.x] != kEmpty) {
+          gap = 0;
+          ends[k] = p;
+          return true;
+        }
+        return ++gap <= options.max_gap;
+      });
+    }
+
+    bool good = std::max(std::abs(ends[1].x - ends[0].x), std::abs(ends[1].y - ends[0].y)) >= options.min_length;
+
+    // Remove the pixels of the segment, and their votes if it is kept
+    for (int k = 0; k < 2; k++) {
+      walker.walk(k == 0 ? 1 : -1, width, height, [&](cv::Point p) {
+        uchar &pixel = state[(std::size_t)p.y * width + p.x];
+        if (pixel == kVoted && good) {
+          for (int t = 0; t < count; t++) {
+            cell(p.x, p.y, t)--;
+          }
+        }
+        pixel = kEmpty;
+        return p != ends[k];
+      });
+    }
+
+    if (good) {
+      segments.push_back({ ends[1], ends[0] });
+      if (options.max_lines > 0 && (int)segments.size() >= options.max_lines) {
+        break;
+      }
+    }
+  }
+
+  return segments;
+}
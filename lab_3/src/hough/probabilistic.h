@@ -0,0 +1,31 @@
+#ifndef __HOUGH_PROBABILISTIC_H__
+#define __HOUGH_PROBABILISTIC_H__
+
+#include "opencv2/opencv.hpp"
+#include "line_segment.h"
+#include "trig_table.h"
+#include <cstdint>
+#include <vector>
+
+struct ProbabilisticOptions {
+  int threshold = 30;  // votes a line needs before its segment is walked
+  int min_length = 20; // shorter segments are dropped, in pixels along the major axis
+  int max_gap = 3;     // missing pixels tolerated inside a segment
+  int max_lines = 0;   // stop after this many segments, 0 for no limit
+  uint64_t seed = 12345;
+};
+
+// Progressive probabilistic Hough transform (Matas et al.). Edge pixels
+// (non-zero pixels of an 8-bit image) vote in random order. As soon as the
+// strongest line through the voting pixel reaches the threshold, the line is
+// walked through that pixel with a fixed-point DDA in both directions, up to
+// max_gap missing pixels. The pixels of the segment are then removed from
+// the image and, if the segment is long enough, their votes from the
+// accumulator, so they never vote again. Work grows with the number of lines
+// rather than the number of edge pixels.
+//
+// The table should cover half a turn, [0, pi): rho is signed here.
+std::vector<LineSegment> probabilistic_hough(const cv::Mat &edges, const TrigTable &table,
+                                             const ProbabilisticOptions &options = {});
+
+#endif // __HOUGH_PROBABILISTIC_H__
@@ -0,0 +1,195 @@
+#include "segments.h"
+#include "../common/logger/logger.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace {
+
+// 32 fraction bits keep the drift of the minor coordinate under 2^-20
+// pixels across any image
+constexpr int kShift = 32;
+constexpr int64_t kOne = int64_t(1) << kShift;
+
+// Fixed-point DDA of a line clipped to the image: steps [start, stop] along
+// the major axis, the minor coordinate at start and its change per step in
+// Q32, rounded by the half already added
+struct Walk {
+  bool x_major;
+  int start, stop;
+  int64_t minor, step;
+};
+
+// Plans the walk of the line across an image of the given size, false when
+// it misses the image
+bool plan_walk(const HoughLine &line, cv::Size size, Walk &walk)
+{
+  const double c = std::cos(line.theta), s = std::sin(line.theta);
+
+  // minor = a + b major along the line, |b| <= 1
+  walk.x_major = std::abs(s) >= std::abs(c);
+  const double a = walk.x_major ? line.rho / s : line.rho / c;
+  const double b = walk.x_major ? -c / s : -s / c;
+  const int majors = walk.x_major ? size.width : size.height;
+  const int minors = walk.x_major ? size.height : size.width;
+
+  // Steps whose minor coordinate rounds into the image
+  double lo = 0, hi = majors - 1;
+  if (b == 0) {
+    if (a < -0.5 || a >= minors - 0.5) {
+      return false;
+    }
+  }
+  else {
+    double e0 = (-0.5 - a) / b, e1 = (minors - 0.5 - a) / b;
+    if (e0 > e1) {
+      std::swap(e0, e1);
+    }
+    lo = std::max(lo, std::ceil(e0));
+    hi = std::min(hi, std::floor(e1));
+  }
+  if (lo > hi) {
+    return false;
+  }
+
+  walk.start = (int)lo;
+  walk.stop = (int)hi;
+  walk.minor = std::llround((a + b * lo) * kOne) + kOne / 2;
+  walk.step = std::llround(b * kOne);
+  return true;
+}
+
+// Segments of one line, in the order of its walk
+void walk_line(const EdgeRuns &edges, const HoughLine &line, const SegmentOptions &options,
+               std::vector<LineSegment> &segments)
+{
+  const cv::Size size = edges.size();
+  Walk walk;
+  if (!plan_walk(line, size, walk)) {
+    return;
+  }
+
+  const int minors = walk.x_major ? size.height : size.width;
+  const int tolerance = std::max(0, options.tolerance);
+  bool open = false;
+  int gap = 0;
+  cv::Point start, last;
+
+  auto close = [&]() {
+    if (open && std::max(std::abs(last.x - start.x), std::abs(last.y - start.y)) >= options.min_length) {
+      segments.push_back({ start, last });
+    }
+    open = false;
+  };
+
+  int64_t minor = walk.minor;
+  for (int major = walk.start; major <= walk.stop; major++, minor += walk.step) {
+    const int m = (int)(minor >> kShift);
+    bool hit = false;
+    cv::Point p;
+
+    if (m >= 0 && m < minors) {
+      if (walk.x_major) {
+        p = cv::Point(major, m);
+        for (int y = std::max(0, m - tolerance); y <= std::min(minors - 1, m + tolerance) && !hit; y++) {
+          hit = edges.any(y, major, major);
+        }
+      }
+      else {
+        p = cv::Point(m, major);
+        hit = edges.any(major, m - tolerance, m + tolerance);
+      }
+    }
+
+    if (hit) {
+      if (!open) {
+        open = true;
+        start = p;
+      }
+      last = p;
+      gap = 0;
+    }
+    else if (open && ++gap > options.max_gap) {
+      close();
+    }
+  }
+  close();
+}
+
+} // namespace
+
+void EdgeRuns::assign(const cv::Mat &edges)
+{
+  width = height = 0;
+  first.clear();
+  begins.clear();
+  ends.clear();
+
+  if (edges.type() != CV_8UC1) {
+    ERROR("Edge runs need an 8-bit single-channel edge image. Keeping no runs.");
+    return;
+  }
+
+  width = edges.cols;
+  height = edges.rows;
+  first.resize(height + 1);
+
+  for (int y = 0; y < height; y++) {
+    first[y] = (int)begins.size();
+    const uchar *row = edges.ptr<uchar>(y);
+    for (int x = 0; x < width;) {
+      if (!row[x]) {
+        x++;
+        continue;
+      }
+      int end = x + 1;
+      while (end < width && row[end]) {
+        end++;
+      }
+      begins.push_back(x);
+      ends.push_back(end);
+      x = end;
+    }
+  }
+  first[height] = (int)begins.size();
+}
+
+bool EdgeRuns::any(int y, int x0, int x1) const
+{
+  if (y < 0 || y >= height) {
+    return false;
+  }
+
+  // The first run of the row ending past x0
+  auto row_end = ends.begin() + first[y + 1];
+  auto run = std::upper_bound(ends.begin() + first[y], row_end, x0);
+  return run != row_end && begins[run - ends.begin()] <= x1;
+}
+
+std::vector<LineSegment> extract_segments(const EdgeRuns &edges, const std::vector<HoughLine> &lines,
+                                          const SegmentOptions &options)
+{
+  if (edges.size().area() == 0 || lines.empty()) {
+    return {};
+  }
+
+  const int count = (int)lines.size();
+  int workers = options.threads > 0 ? options.threads : cv::getNumThreads();
+  workers = std::max(1, std::min(workers, count));
+  std::vector<std::vector<LineSegment>> found(count);
+
+  cv::parallel_for_(cv::Range(0, workers), [&](const cv::Range &range) {
+    for (int w = range.start; w < range.end; w++) {
+      for (int l = w; l < count; l += workers) {
+        walk_line(edges, lines[l], options, found[l]);
+      }
+    }
+  }, workers);
+
+  std::vector<LineSegment> segments;
+  for (const std::vector<LineSegment> &line : found) {
+    segments.insert(segments.end(), line.begin(), line.end());
+  }
+  return segments;
+}
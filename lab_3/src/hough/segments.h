@@ -0,0 +1,49 @@
+#ifndef __HOUGH_SEGMENTS_H__
+#define __HOUGH_SEGMENTS_H__
+
+#include "opencv2/opencv.hpp"
+#include "line_segment.h"
+#include <vector>
+
+// Edge pixels (non-zero pixels of an 8-bit image) as runs of consecutive
+// pixels along each row. Whether a row has an edge pixel within a span of
+// columns takes one binary search over the runs of that row.
+class EdgeRuns {
+  int width = 0, height = 0;
+  std::vector<int> first; // index of the first run of each row, and one past the last run
+  std::vector<int> begins, ends; // columns [begin, end) of each run
+
+public:
+  EdgeRuns() = default;
+  explicit EdgeRuns(const cv::Mat &edges) { assign(edges); }
+
+  // Replaces the runs with those of another image, keeping the memory
+  void assign(const cv::Mat &edges);
+
+  cv::Size size() const { return cv::Size(width, height); }
+  std::size_t runs() const { return begins.size(); }
+  // Whether row y has an edge pixel in columns [x0, x1]
+  bool any(int y, int x0, int x1) const;
+};
+
+struct SegmentOptions {
+  int min_length = 20; // shorter segments are dropped, in pixels along the major axis
+  int max_gap = 3;     // missing pixels tolerated inside a segment
+  // Pixels across the line, on each side, an edge pixel may lie off it and
+  // still count, for lines slightly off their pixels
+  int tolerance = 1;
+  int threads = 0; // 0 uses cv::getNumThreads()
+};
+
+// The segments of the lines supported by edge pixels. Each line is walked
+// across the image with a fixed-point DDA, one pixel per step along its
+// major axis, from where it enters the image to where it leaves, so a line
+// costs its length in the image, not the image size. A segment runs while
+// no more than max_gap consecutive steps miss an edge pixel. Its ends are
+// the first and last steps that hit one, on the line, and so within
+// tolerance of an edge pixel. Lines are walked in parallel; the segments
+// come in the order of the lines, each line's along its walk.
+std::vector<LineSegment> extract_segments(const EdgeRuns &edges, const std::vector<HoughLine> &lines,
+                                          const SegmentOptions &options = {});
+
+#endif // __HOUGH_SEGMENTS_H__
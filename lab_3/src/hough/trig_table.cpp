@@ -0,0 +1,17 @@
+#include "trig_table.h"
+
+#include <cmath>
+
+TrigTable::TrigTable(int count, double step, double first)
+  :first(first), step(step), cosines(count), sines(count), cos_fixed(count), sin_fixed(count)
+{
+  const double scale = (double)(1 << kFractionBits);
+
+  for (int t = 0; t < count; t++) {
+    double theta = angle(t);
+    cosines[t] = std::cos(theta);
+    sines[t] = std::sin(theta);
+    cos_fixed[t] = (int32_t)std::lround(cosines[t] * scale);
+    sin_fixed[t] = (int32_t)std::lround(sines[t] * scale);
+  }
+}
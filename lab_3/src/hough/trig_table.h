@@ -0,0 +1,40 @@
+#ifndef __HOUGH_TRIG_TABLE_H__
+#define __HOUGH_TRIG_TABLE_H__
+
+#include <cstdint>
+#include <vector>
+
+// cos and sin of evenly spaced angles, computed once per accumulator instead
+// of once per vote. The fixed-point copies have kFractionBits fractional bits,
+// so rho = (x * cos + y * sin + kHalf) >> kFractionBits rounds x cos + y sin
+// to the nearest integer with integer arithmetic only, as long as
+// sqrt(x^2 + y^2) stays below 2^(31 - kFractionBits).
+class TrigTable {
+public:
+  static constexpr int kFractionBits = 16;
+  static constexpr int32_t kHalf = 1 << (kFractionBits - 1);
+
+private:
+  double first;
+  double step;
+  std::vector<double> cosines;
+  std::vector<double> sines;
+  std::vector<int32_t> cos_fixed;
+  std::vector<int32_t> sin_fixed;
+
+public:
+  // count angles first, first + step, ... in radians
+  TrigTable(int count, double step, double first = 0.0);
+
+  int size() const { return (int)cosines.size(); }
+  double angle(int t) const { return first + t * step; }
+  double angle_step() const { return step; }
+
+  double cos(int t) const { return cosines[t]; }
+  double sin(int t) const { return sines[t]; }
+
+  const int32_t *cos_q() const { return cos_fixed.data(); }
+  const int32_t *sin_q() const { return sin_fixed.data(); }
+};
+
+#endif // __HOUGH_TRIG_TABLE_H__
@@ -4,6 +4,7 @@
 #include "src/common/common.h"
 #include "src/slider/slider.h"
 #include "src/common/logger/logger.h"
+#include "src/ght/generalized_hough.h"
 
 using namespace cv;
 using namespace std;
@@ -14,6 +15,9 @@ int weight[9] = {3, 2, 3, 2, 0, 2, 3, 2, 3};
 
 Mat_<uchar> perform_chamfer_DT(Mat_<uchar> src);
 double compute_matching_score(Mat_<uchar> dt, Mat_<uchar> object);
+double compute_placed_score(Mat_<uchar> dt, const vector<Point>& points);
+void locate_template(const RTable& table, const PointCoordinates<int>& templatePoints, Mat_<uchar> object,
+                     const string& windowName);
 
 int main() {
     Mat_<uchar> img = imread("assets/images_DT_PM/PatternMatching/template.bmp", IMREAD_GRAYSCALE);
@@ -47,6 +51,17 @@ int main() {
     double score3 = compute_matching_score(dt, object3);
     cout << "Matching score 3: " << score3<< endl;
 
+    // Find where the template lies in each object with a generalized Hough
+    // transform, and score it there instead of at its own location
+    bool locate = true;
+    if (locate) {
+        PointCoordinates<int> templatePoints = extractPoints<int>(img, PixelPredicate::equal(0));
+        RTable table(templatePoints, contour_normals(templatePoints, img.size()));
+
+        locate_template(table, templatePoints, object2, "Located In Object 2");
+        locate_template(table, templatePoints, object3, "Located In Object 3");
+    }
+
     waitKey(0);
 
     return 0;
@@ -128,3 +143,68 @@ double compute_matching_score(Mat_<uchar> dt, Mat_<uchar> object) {
 
     return contourPointsCounter > 0 ? total / contourPointsCounter : 255;
 }
+
+double compute_placed_score(Mat_<uchar> dt, const vector<Point>& points) {
+    double total = 0;
+
+    // Points placed outside of the image are as far as can be
+    for (const Point& p : points) {
+        if (p.x >= 0 && p.x < dt.cols && p.y >= 0 && p.y < dt.rows) {
+            total += dt(p.y, p.x);
+        }
+        else {
+            total += 255;
+        }
+    }
+
+    return points.empty() ? 255 : total / points.size();
+}
+
+void locate_template(const RTable& table, const PointCoordinates<int>& templatePoints, Mat_<uchar> object,
+                     const string& windowName) {
+    PointCoordinates<int> objectPoints = extractPoints<int>(object, PixelPredicate::equal(0));
+    vector<float> normals = contour_normals(objectPoints, object.size());
+
+    // Rotations up to 30 degrees either way and scales from 0.8 to 1.2
+    GhtOptions options;
+    options.min_rotation = -30 * CV_PI / 180;
+    options.max_rotation = 30 * CV_PI / 180;
+    options.min_scale = 0.8;
+    options.max_scale = 1.2;
+
+    vector<GhtCandidate> candidates = generalized_hough(table, objectPoints, normals, object.size(), options);
+    if (candidates.empty()) {
+        cout << windowName << ": no candidate location" << endl;
+        return;
+    }
+
+    // The chamfer distance only needs computing at the few candidates
+    Mat_<uchar> dt = perform_chamfer_DT(object);
+    double bestScore = numeric_limits<double>::max();
+    vector<Point> best;
+
+    for (const GhtCandidate& candidate : candidates) {
+        vector<Point> placed = place_template(templatePoints, table, candidate);
+        double score = compute_placed_score(dt, placed);
+
+        cout << windowName << ": reference (" << candidate.location.x << ", " << candidate.location.y
+             << "), rotation " << candidate.rotation * 180 / CV_PI << " degrees, scale " << candidate.scale
+             << ", " << candidate.votes << " votes, matching score " << score << endl;
+
+        if (score < bestScore) {
+            bestScore = score;
+            best = placed;
+        }
+    }
+
+    Mat located;
+    cvtColor(object, located, COLOR_GRAY2BGR);
+    for (const Point& p : best) {
+        if (p.x >= 0 && p.x < located.cols && p.y >= 0 && p.y < located.rows) {
+            located.at<Vec3b>(p.y, p.x) = Vec3b(0, 0, 255);
+        }
+    }
+
+    namedWindow(windowName, WINDOW_KEEPRATIO);
+    imshow(windowName, located);
+}
@@ -0,0 +1,233 @@
+#include "generalized_hough.h"
+#include "../common/logger/logger.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// Direction modulo pi, in [0, pi)
+inline double half_turn(double angle)
+{
+  angle = std::fmod(angle, CV_PI);
+  return angle < 0 ? angle + CV_PI : angle;
+}
+
+struct Pose {
+  double rotation, scale;
+};
+
+// The strongest local maxima of one accumulator, at most count of them,
+// strongest first; ties go to the first cell in row-major order
+std::vector<GhtCandidate> local_maxima(const cv::Mat &acc, int window, int count, const Pose &pose)
+{
+  const int half = window / 2;
+  std::vector<GhtCandidate> best;
+
+  for (int y = 0; y < acc.rows; y++) {
+    const int *row = acc.ptr<int>(y);
+    for (int x = 0; x < acc.cols; x++) {
+      const int votes = row[x];
+      if (votes == 0 || ((int)best.size() == count && votes <= best.back().votes)) {
+        continue;
+      }
+
+      bool maximum = true;
+      for (int dy = -half; dy <= half && maximum; dy++) {
+        if (y + dy < 0 || y + dy >= acc.rows) {
+          continue;
+        }
+        const int *other = acc.ptr<int>(y + dy);
+        for (int dx = -half; dx <= half; dx++) {
+          if (x + dx < 0 || x + dx >= acc.cols || (dx == 0 && dy == 0)) {
+            continue;
+          }
+          // Earlier cells win ties
+          bool earlier = dy < 0 || (dy == 0 && dx < 0);
+          if (other[x + dx] > votes || (earlier && other[x + dx] == votes)) {
+            maximum = false;
+            break;
+          }
+        }
+      }
+      if (!maximum) {
+        continue;
+      }
+
+      GhtCandidate candidate = { cv::Point(x, y), pose.rotation, pose.scale, votes };
+      auto at = std::upper_bound(best.begin(), best.end(), candidate,
+                                 [](const GhtCandidate &a, const GhtCandidate &b) { return a.votes > b.votes; });
+      best.insert(at, candidate);
+      if ((int)best.size() > count) {
+        best.pop_back();
+      }
+    }
+  }
+  return best;
+}
+
+} // namespace
+
+std::vector<float> contour_normals(const PointCoordinates<int> &points, cv::Size size, int radius)
+{
+  cv::Mat mask = cv::Mat::zeros(size.height, size.width, CV_8UC1);
+  for (std::size_t i = 0; i < points.size(); i++) {
+    mask.at<uchar>(points.y[i], points.x[i]) = 1;
+  }
+
+  std::vector<float> normals(points.size());
+  for (std::size_t i = 0; i < points.size(); i++) {
+    const int x = points.x[i], y = points.y[i];
+    double sxx = 0, syy = 0, sxy = 0;
+    int neighbors = 0;
+
+    for (int v = std::max(0, y - radius); v <= std::min(size.height - 1, y + radius); v++) {
+      const uchar *row = mask.ptr<uchar>(v);
+      for (int u = std::max(0, x - radius); u <= std::min(size.width - 1, x + radius); u++) {
+        if (row[u] && (u != x || v != y)) {
+          sxx += (u - x) * (u - x);
+          syy += (v - y) * (v - y);
+          sxy += (u - x) * (v - y);
+          neighbors++;
+        }
+      }
+    }
+
+    if (neighbors == 0) {
+      normals[i] = std::numeric_limits<float>::quiet_NaN();
+      continue;
+    }
+
+    // Principal axis of the neighbors around the point, the tangent
+    double tangent = 0.5 * std::atan2(2 * sxy, sxx - syy);
+    normals[i] = (float)half_turn(tangent + CV_PI / 2);
+  }
+  return normals;
+}
+
+RTable::RTable(const PointCoordinates<int> &points, const std::vector<float> &normals, int bins)
+  :bins(std::max(1, bins)), entries(std::max(1, bins)), reference(0, 0)
+{
+  if (points.empty() || normals.size() != points.size()) {
+    ERROR("An R-table needs contour points with one normal each. The table is empty.");
+    return;
+  }
+
+  double sx = 0, sy = 0;
+  for (std::size_t i = 0; i < points.size(); i++) {
+    sx += points.x[i];
+    sy += points.y[i];
+  }
+  reference = cv::Point2f((float)(sx / points.size()), (float)(sy / points.size()));
+
+  for (std::size_t i = 0; i < points.size(); i++) {
+    if (!std::isnan(normals[i])) {
+      entries[bin(normals[i])].push_back(cv::Point2f(reference.x - points.x[i], reference.y - points.y[i]));
+    }
+  }
+}
+
+int RTable::bin(double normal) const
+{
+  return std::min(bins - 1, (int)(half_turn(normal) / CV_PI * bins));
+}
+
+std::vector<GhtCandidate> generalized_hough(const RTable &table, const PointCoordinates<int> &points,
+                                            const std::vector<float> &normals, cv::Size size,
+                                            const GhtOptions &options)
+{
+  if (normals.size() != points.size()) {
+    ERROR("The generalized Hough transform needs one normal per point. Returning no candidates.");
+    return {};
+  }
+  if (!(options.rotation_step > 0) || !(options.scale_step > 0) || options.min_scale <= 0) {
+    ERROR("The generalized Hough transform needs positive rotation and scale steps and scales. Returning no candidates.");
+    return {};
+  }
+
+  std::vector<Pose> poses;
+  for (double rotation = options.min_rotation; rotation <= options.max_rotation + 1e-9;
+       rotation += options.rotation_step) {
+    for (double scale = options.min_scale; scale <= options.max_scale + 1e-9; scale += options.scale_step) {
+      poses.push_back({ rotation, scale });
+    }
+  }
+
+  int workers = options.threads > 0 ? options.threads : cv::getNumThreads();
+  workers = std::max(1, std::min(workers, (int)poses.size()));
+  std::vector<std::vector<GhtCandidate>> found(poses.size());
+
+  cv::parallel_for_(cv::Range(0, workers), [&](const cv::Range &range) {
+    cv::Mat acc(size.height, size.width, CV_32SC1);
+
+    for (int w = range.start; w < range.end; w++) {
+      for (std::size_t p = w; p < poses.size(); p += workers) {
+        const Pose &pose = poses[p];
+        const float c = (float)(pose.scale * std::cos(pose.rotation));
+        const float s = (float)(pose.scale * std::sin(pose.rotation));
+        acc.setTo(0);
+
+        for (std::size_t i = 0; i < points.size(); i++) {
+          if (std::isnan(normals[i])) {
+            continue;
+          }
+
+          // The template normal this one was, before the rotation
+          const int own = table.bin(normals[i] - pose.rotation);
+          for (int k = -options.bin_spread; k <= options.bin_spread; k++) {
+            for (const cv::Point2f &r : table.at(((own + k) % table.size() + table.size()) % table.size())) {
+              int x = (int)std::lround(points.x[i] + c * r.x - s * r.y);
+              int y = (int)std::lround(points.y[i] + s * r.x + c * r.y);
+              if ((unsigned)x < (unsigned)size.width && (unsigned)y < (unsigned)size.height) {
+                acc.ptr<int>(y)[x]++;
+              }
+            }
+          }
+        }
+
+        found[p] = local_maxima(acc, options.window, options.candidates, pose);
+      }
+    }
+  }, workers);
+
+  // The strongest over all poses, one per location
+  std::vector<GhtCandidate> all;
+  for (const std::vector<GhtCandidate> &pose : found) {
+    all.insert(all.end(), pose.begin(), pose.end());
+  }
+  std::stable_sort(all.begin(), all.end(),
+                   [](const GhtCandidate &a, const GhtCandidate &b) { return a.votes > b.votes; });
+
+  std::vector<GhtCandidate> candidates;
+  const int half = options.window / 2;
+  for (const GhtCandidate &candidate : all) {
+    bool taken = std::any_of(candidates.begin(), candidates.end(), [&](const GhtCandidate &kept) {
+      return std::abs(kept.location.x - candidate.location.x) <= half &&
+             std::abs(kept.location.y - candidate.location.y) <= half;
+    });
+    if (!taken) {
+      candidates.push_back(candidate);
+      if ((int)candidates.size() >= options.candidates) {
+        break;
+      }
+    }
+  }
+  return candidates;
+}
+
+std::vector<cv::Point> place_template(const PointCoordinates<int> &points, const RTable &table,
+                                      const GhtCandidate &candidate)
+{
+  const double c = candidate.scale * std::cos(candidate.rotation);
+  const double s = candidate.scale * std::sin(candidate.rotation);
+  const cv::Point2f reference = table.reference_point();
+
+  std::vector<cv::Point> placed(points.size());
+  for (std::size_t i = 0; i < points.size(); i++) {
+    double dx = points.x[i] - reference.x, dy = points.y[i] - reference.y;
+    placed[i] = cv::Point((int)std::lround(candidate.location.x + c * dx - s * dy),
+                          (int)std::lround(candidate.location.y + s * dx + c * dy));
+  }
+  return placed;
+}
@@ -0,0 +1,72 @@
+#ifndef __GHT_GENERALIZED_HOUGH_H__
+#define __GHT_GENERALIZED_HOUGH_H__
+
+#include "opencv2/opencv.hpp"
+#include "../common/points/point_extractor.h"
+#include <vector>
+
+// Direction of the contour normal at every point, in [0, pi) radians: the
+// normal of the principal axis of the contour points within radius pixels
+// of it. A thin contour has no usable intensity gradient, and its sides are
+// indistinguishable, so the direction is only defined modulo pi. Points
+// with no neighbor get NaN.
+std::vector<float> contour_normals(const PointCoordinates<int> &points, cv::Size size, int radius = 2);
+
+// Displacements from the contour points of a template to its reference
+// point, binned by the normal direction at the point
+class RTable {
+  int bins;
+  std::vector<std::vector<cv::Point2f>> entries;
+  cv::Point2f reference;
+
+public:
+  // From the contour points and their normals; the reference point is their
+  // centroid
+  RTable(const PointCoordinates<int> &points, const std::vector<float> &normals, int bins = 90);
+
+  int size() const { return bins; }
+  int bin(double normal) const;
+  const std::vector<cv::Point2f> &at(int bin) const { return entries[bin]; }
+  cv::Point2f reference_point() const { return reference; }
+};
+
+struct GhtOptions {
+  // Poses tried: rotations from min_rotation to max_rotation and scales from
+  // min_scale to max_scale, both ends included
+  double min_rotation = 0.0;
+  double max_rotation = 0.0;
+  double rotation_step = 5 * CV_PI / 180;
+  double min_scale = 1.0;
+  double max_scale = 1.0;
+  double scale_step = 0.1;
+  // R-table bins on each side of a point's own that it also votes from, to
+  // absorb the error of its normal
+  int bin_spread = 1;
+  int window = 5;     // peak suppression window in the reference accumulator
+  int candidates = 5; // strongest peaks kept over all poses
+  int threads = 0;    // 0 uses cv::getNumThreads()
+};
+
+struct GhtCandidate {
+  cv::Point location; // of the template reference point in the image
+  double rotation;    // radians
+  double scale;
+  int votes;
+};
+
+// Generalized Hough transform: every image point looks up the template
+// displacements stored under its normal direction, turned back by the
+// rotation of the pose, and votes for the reference point at each of them
+// rotated and scaled. Poses are voted in parallel, each worker reusing one
+// image-sized accumulator. Returns the strongest local maxima over all
+// poses, strongest first.
+std::vector<GhtCandidate> generalized_hough(const RTable &table, const PointCoordinates<int> &points,
+                                            const std::vector<float> &normals, cv::Size size,
+                                            const GhtOptions &options = {});
+
+// The template points relative to the table reference, placed with the pose
+// of the candidate
+std::vector<cv::Point> place_template(const PointCoordinates<int> &points, const RTable &table,
+                                      const GhtCandidate &candidate);
+
+#endif // __GHT_GENERALIZED_HOUGH_H__
@@ -0,0 +1,314 @@
+#include "point_extractor.h"
+#include "../logger/logger.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define POINT_EXTRACTOR_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Single-channel test: low <= v <= high, inverted with negate. v is in range
+// exactly when v - low, wrapped to a byte, is at most high - low.
+struct RowTest {
+  uchar low;
+  uchar span;
+  bool negate;
+};
+
+// Matching columns in [from, cols) of a single-channel row. emit(j) is called
+// for each of them, in order, when Emit is true.
+template <bool Emit, typename F>
+inline std::size_t scanScalar(const uchar *row, int from, int cols, RowTest test, F &emit)
+{
+  std::size_t count = 0;
+  for (int j = from; j < cols; j++) {
+    if (((uchar)(row[j] - test.low) <= test.span) != test.negate) {
+      if constexpr (Emit) {
+        emit(j);
+      }
+      count++;
+    }
+  }
+  return count;
+}
+
+#ifdef POINT_EXTRACTOR_X86
+
+template <bool Emit, typename F>
+inline std::size_t scanSse2(const uchar *row, int cols, RowTest test, F &emit)
+{
+  const __m128i low = _mm_set1_epi8((char)test.low);
+  const __m128i span = _mm_set1_epi8((char)test.span);
+  const unsigned flip = test.negate ? 0xFFFFu : 0u;
+
+  std::size_t count = 0;
+  int j = 0;
+
+  for (; j + 16 <= cols; j += 16) {
+    __m128i v = _mm_sub_epi8(_mm_loadu_si128((const __m128i *)(row + j)), low);
+    unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(v, span), v)) ^ flip;
+    count += __builtin_popcount(mask);
+
+    if constexpr (Emit) {
+      for (; mask != 0; mask &= mask - 1) {
+        emit(j + __builtin_ctz(mask));
+      }
+    }
+  }
+
+  return count + scanScalar<Emit>(row, j, cols, test, emit);
+}
+
+template <bool Emit, typename F>
+__attribute__((target("avx2,popcnt,bmi")))
+std::size_t scanAvx2(const uchar *row, int cols, RowTest test, F &emit)
+{
+  const __m256i low = _mm256_set1_epi8((char)test.low);
+  const __m256i span = _mm256_set1_epi8((char)test.span);
+  const uint32_t flip = test.negate ? 0xFFFFFFFFu : 0u;
+
+  std::size_t count = 0;
+  int j = 0;
+
+  for (; j + 32 <= cols; j += 32) {
+    __m256i v = _mm256_sub_epi8(_mm256_loadu_si256((const __m256i *)(row + j)), low);
+    uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_min_epu8(v, span), v)) ^ flip;
+    count += _mm_popcnt_u32(mask);
+
+    if constexpr (Emit) {
+      for (; mask != 0; mask = _blsr_u32(mask)) {
+        emit(j + (int)_tzcnt_u32(mask));
+      }
+    }
+  }
+
+  return count + scanScalar<Emit>(row, j, cols, test, emit);
+}
+
+bool hasAvx2()
+{
+  static const bool avx2 = [] {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt") && __builtin_cpu_supports("bmi");
+  }();
+  return avx2;
+}
+
+#endif
+
+// 1 where every channel of a pixel is within the predicate's range, else 0
+template <int Channels>
+void matchChannels(const uchar *row, int cols, const PixelPredicate &predicate, uchar *out)
+{
+  uchar span[Channels];
+  for (int c = 0; c < Channels; c++) {
+    span[c] = predicate.high[c] - predicate.low[c];
+  }
+
+  for (int j = 0; j < cols; j++) {
+    uchar match = 1;
+    for (int c = 0; c < Channels; c++) {
+      match &= (uchar)(row[j * Channels + c] - predicate.low[c]) <= span[c];
+    }
+    out[j] = match;
+  }
+}
+
+class RowScanner {
+  const cv::Mat &img;
+  const PixelPredicate &predicate;
+  RowTest test;
+  bool empty = false;
+
+public:
+  RowScanner(const cv::Mat &img, const PixelPredicate &predicate)
+    :img(img), predicate(predicate)
+  {
+    // A range with low above high matches no pixel, whatever the others are
+    for (int c = 0; c < img.channels(); c++) {
+      empty |= predicate.low[c] > predicate.high[c];
+    }
+
+    // Color pixels are first reduced to one 0 or 1 byte each
+    if (empty) {
+      test = { 0, 255, !predicate.negate };
+    }
+    else if (img.channels() == 1) {
+      test = { predicate.low[0], (uchar)(predicate.high[0] - predicate.low[0]), predicate.negate };
+    }
+    else {
+      test = { 1, 0, predicate.negate };
+    }
+  }
+
+  // Matching pixels of row i; scratch holds img.cols bytes for color images
+  template <bool Emit, typename F>
+  std::size_t scan(int i, uchar *scratch, F &emit) const
+  {
+    const uchar *row = img.ptr<uchar>(i);
+
+    switch (empty ? 1 : img.channels()) {
+      case 2:
+        matchChannels<2>(row, img.cols, predicate, scratch);
+        row = scratch;
+        break;
+      case 3:
+        matchChannels<3>(row, img.cols, predicate, scratch);
+        row = scratch;
+        break;
+      case 4:
+        matchChannels<4>(row, img.cols, predicate, scratch);
+        row = scratch;
+        break;
+    }
+
+#ifdef POINT_EXTRACTOR_X86
+    if (hasAvx2()) {
+      return scanAvx2<Emit>(row, img.cols, test, emit);
+    }
+    return scanSse2<Emit>(row, img.cols, test, emit);
+#else
+    return scanScalar<Emit>(row, 0, img.cols, test, emit);
+#endif
+  }
+};
+
+// A few bands per thread, so uneven rows still balance
+int bandCount(int rows)
+{
+  return std::max(1, std::min(rows, cv::getNumThreads() * 4));
+}
+
+// Calls body(i, scratch) for every row, in parallel over row bands
+template <typename Body>
+void forEachRow(const cv::Mat &img, Body body)
+{
+  const int rows = img.rows;
+  const int bands = bandCount(rows);
+
+  cv::parallel_for_(cv::Range(0, bands), [&](const cv::Range &range) {
+    std::vector<uchar> scratch(img.channels() > 1 ? img.cols : 0);
+    for (int b = range.start; b < range.end; b++) {
+      for (int i = rows * b / bands; i < rows * (b + 1) / bands; i++) {
+        body(i, scratch.data());
+      }
+    }
+  }, bands);
+}
+
+bool supported(const cv::Mat &img)
+{
+  if (img.depth() != CV_8U || img.channels() > 4) {
+    ERROR("Point extraction needs an 8-bit image with at most 4 channels. Returning no points.");
+    return false;
+  }
+  return true;
+}
+
+// Points of every row, and with that the offset of each row in the output
+std::vector<std::size_t> rowOffsets(const cv::Mat &img, const PixelPredicate &predicate)
+{
+  RowScanner scanner(img, predicate);
+  std::vector<std::size_t> offsets(img.rows + 1, 0);
+
+  forEachRow(img, [&](int i, uchar *scratch) {
+    auto none = [](int) {};
+    offsets[i + 1] = scanner.scan<false>(i, scratch, none);
+  });
+
+  for (int i = 0; i < img.rows; i++) {
+    offsets[i + 1] += offsets[i];
+  }
+  return offsets;
+}
+
+template <typename T>
+void writePoints(const cv::Mat &img, const PixelPredicate &predicate, const std::vector<std::size_t> &offsets,
+                 T *xs, T *ys)
+{
+  RowScanner scanner(img, predicate);
+
+  forEachRow(img, [&](int i, uchar *scratch) {
+    T *x = xs + offsets[i];
+    T *y = ys + offsets[i];
+    const T row = (T)i;
+    auto emit = [&](int j) {
+      *x++ = (T)j;
+      *y++ = row;
+    };
+    scanner.scan<true>(i, scratch, emit);
+  });
+}
+
+} // namespace
+
+PixelPredicate PixelPredicate::equal(uchar value)
+{
+  PixelPredicate predicate;
+  std::fill(predicate.low, predicate.low + 4, value);
+  std::fill(predicate.high, predicate.high + 4, value);
+  return predicate;
+}
+
+PixelPredicate PixelPredicate::notEqual(uchar value)
+{
+  PixelPredicate predicate = equal(value);
+  predicate.negate = true;
+  return predicate;
+}
+
+PixelPredicate PixelPredicate::inRange(const cv::Scalar &low, const cv::Scalar &high)
+{
+  PixelPredicate predicate;
+  for (int c = 0; c < 4; c++) {
+    predicate.low[c] = cv::saturate_cast<uchar>(low[c]);
+    predicate.high[c] = cv::saturate_cast<uchar>(high[c]);
+  }
+  return predicate;
+}
+
+std::size_t countPoints(const cv::Mat &img, const PixelPredicate &predicate)
+{
+  if (img.empty() || !supported(img)) {
+    return 0;
+  }
+  return rowOffsets(img, predicate).back();
+}
+
+template <typename T>
+std::size_t extractPoints(const cv::Mat &img, const PixelPredicate &predicate, T *xs, T *ys)
+{
+  if (img.empty() || !supported(img)) {
+    return 0;
+  }
+
+  std::vector<std::size_t> offsets = rowOffsets(img, predicate);
+  writePoints(img, predicate, offsets, xs, ys);
+  return offsets.back();
+}
+
+template <typename T>
+PointCoordinates<T> extractPoints(const cv::Mat &img, const PixelPredicate &predicate)
+{
+  PointCoordinates<T> points;
+  if (img.empty() || !supported(img)) {
+    return points;
+  }
+
+  std::vector<std::size_t> offsets = rowOffsets(img, predicate);
+  points.x.resize(offsets.back());
+  points.y.resize(offsets.back());
+  writePoints(img, predicate, offsets, points.x.data(), points.y.data());
+  return points;
+}
+
+template std::size_t extractPoints<int>(const cv::Mat &, const PixelPredicate &, int *, int *);
+template std::size_t extractPoints<float>(const cv::Mat &, const PixelPredicate &, float *, float *);
+template std::size_t extractPoints<double>(const cv::Mat &, const PixelPredicate &, double *, double *);
+
+template PointCoordinates<int> extractPoints<int>(const cv::Mat &, const PixelPredicate &);
+template PointCoordinates<float> extractPoints<float>(const cv::Mat &, const PixelPredicate &);
+template PointCoordinates<double> extractPoints<double>(const cv::Mat &, const PixelPredicate &);
@@ -9,15 +9,15 @@
 using namespace cv;
 using namespace std;
 
-Mat_<int> convert_image_to_points_2d(Mat img);
-void apply_k_means(Mat_<int> points, int k, Mat src);
-void initialize(Mat_<int> points, int k, Mat_<int>& centroids);
+void apply_k_means(const PointCoordinates<int>& points, int k, Mat src);
+void initialize(const PointCoordinates<int>& points, int k, Mat_<int>& centroids);
 void display_centroids(Mat_<int> centroids, Mat src, string name);
-double find_euclidean_distance(Mat_<int> p1, Mat_<int> p2);
+double find_euclidean_distance(Point p1, Point p2);
 
 int main() {
     Mat img = imread("./assets/images_Kmeans/points4.bmp", IMREAD_GRAYSCALE);
-    Mat_<int> points = convert_image_to_points_2d(img);
+    // The black points, clustered straight from the extractor's x and y arrays
+    PointCoordinates<int> points = extractPoints<int>(img, PixelPredicate::equal(0));
 
     namedWindow("Initial image", WINDOW_KEEPRATIO);
     imshow("Initial image", img);
@@ -29,34 +29,14 @@ int main() {
     return 0;
 }
 
-Mat_<int> convert_image_to_points_2d(Mat img) {
-    vector<Point> points;
-
-    for (int i = 0; i < img.rows; i++) {
-        for (int j = 0; j < img.cols; j++) {
-            if (img.at<uchar>(i, j) == 0) {
-                points.push_back(Point(j, i));
-            }
-        }
-    }
-
-    Mat_<int> matPoints(points.size(), 2);
-
-    for (int i = 0; i < points.size(); i++) {
-        matPoints(i, 0) = points[i].x;
-        matPoints(i, 1) = points[i].y;
-    }
-
-    return matPoints;
-}
-
-void initialize(Mat_<int> points, int k, Mat_<int>& centroids) {
+void initialize(const PointCoordinates<int>& points, int k, Mat_<int>& centroids) {
     default_random_engine gen;
-    uniform_int_distribution<int> distribution(0, points.rows - 1);
+    uniform_int_distribution<int> distribution(0, (int)points.size() - 1);
 
     for (int i = 0; i < k; i++) {
         int idx = distribution(gen);
-        points.row(idx).copyTo(centroids.row(i));
+        centroids(i, 0) = points.x[idx];
+        centroids(i, 1) = points.y[idx];
     }
 }
 
@@ -70,11 +50,11 @@ void display_centroids(Mat_<int> centroids, Mat src, string name) {
     imshow(name, src);
 }
 
-double find_euclidean_distance(Mat_<int> p1, Mat_<int> p2) {
-    double x1 = p1(0, 0);
-    double y1 = p1(0, 1);
-    double x2 = p2(0, 0);
-    double y2 = p2(0, 1);
+double find_euclidean_distance(Point p1, Point p2) {
+    double x1 = p1.x;
+    double y1 = p1.y;
+    double x2 = p2.x;
+    double y2 = p2.y;
 
     double dx = x1 - x2;
     double dy = y1 - y2;
@@ -82,8 +62,9 @@ double find_euclidean_distance(Mat_<int> p1, Mat_<int> p2) {
     return sqrt(dx * dx + dy * dy);
 }
 
-void apply_k_means(Mat_<int> points, int k, Mat src) {
-    int d = points.cols;
+void apply_k_means(const PointCoordinates<int>& points, int k, Mat src) {
+    int n = (int)points.size();
+    int d = 2;
     Mat_<int> centroids(k,d);
     centroids.setTo(0);
 
@@ -93,17 +74,18 @@ void apply_k_means(Mat_<int> points, int k, Mat src) {
     bool change = true;
     int maxIterations = 100;
     int iteration = 0;
-    Mat_<int> labels(points.rows, 1);
+    Mat_<int> labels(n, 1);
 
     while (change && iteration < maxIterations) {
         change = false;
 
-        for (int i = 0; i < points.rows; i++) {
+        for (int i = 0; i < n; i++) {
+            Point p(points.x[i], points.y[i]);
             double minDist = DBL_MAX;
             int bestCluster = -1;
 
             for (int j = 0; j < k; j++) {
-                double dist = find_euclidean_distance(points.row(i), centroids.row(j));
+                double dist = find_euclidean_distance(p, Point(centroids(j, 0), centroids(j, 1)));
 
                 if (dist < minDist) {
                     minDist = dist;
@@ -122,9 +104,10 @@ void apply_k_means(Mat_<int> points, int k, Mat src) {
         newCentroids.setTo(0);
         counts.setTo(0);
 
-        for (int i = 0; i < points.rows; i++) {
+        for (int i = 0; i < n; i++) {
             int cluster = labels(i, 0);
-            newCentroids.row(cluster) += points.row(i);
+            newCentroids(cluster, 0) += points.x[i];
+            newCentroids(cluster, 1) += points.y[i];
             counts(cluster, 0)++;
         }
 
@@ -151,9 +134,9 @@ void apply_k_means(Mat_<int> points, int k, Mat src) {
         colors[i] = Vec3b(rng.uniform(0, 255), rng.uniform(0, 255), rng.uniform(0, 255));
     }
 
-    for (int i = 0; i < points.rows; i++) {
-        int x = points(i, 0);
-        int y = points(i, 1);
+    for (int i = 0; i < n; i++) {
+        int x = points.x[i];
+        int y = points.y[i];
         int lbl = labels(i, 0);
         clustered.at<Vec3b>(y, x) = colors[lbl];
     }
@@ -5,6 +5,7 @@
 #include "./logger/logger.h"
 #include "./file/file_utils.h"
 #include "misc.h"
+#include "./points/point_extractor.h"
 
 #include <string>
 #include <cstddef>